@@ -211,6 +211,7 @@ EX void present_surface() {
   }
 
 EX void present_screen() {
+  if(headless) return;
 #if CAP_GL
   if(vid.usingGL) {
     #if SDLVER >= 2
@@ -1280,6 +1281,9 @@ EX void close_renderer() {
   }
 
 EX void close_window() {
+  #if CAP_EGL
+  if(headless) close_headless();
+  #endif
   #if SDLVER >= 2
   close_renderer();
   if(s_have_context) {
@@ -1292,6 +1296,7 @@ EX void close_window() {
 EX void apply_screen_settings() {
   if(!need_to_apply_screen_settings()) return;
   if(!graphics_on) return;
+  if(headless) return;
  
 #if ISANDROID
   if(vid.full != vid.want_fullscreen)
@@ -1508,6 +1513,69 @@ EX void setvideomode() {
 
 EX bool noGUI = false;
 
+/** render only into offscreen buffers, without a window or a display (for -shot and -animvideo on servers) */
+EX bool headless = false;
+
+#if CAP_EGL
+EGLDisplay egl_display = EGL_NO_DISPLAY;
+EGLContext egl_context = EGL_NO_CONTEXT;
+
+/** create a surfaceless OpenGL context; there is no default framebuffer, so everything has to be drawn into renderbuffers */
+bool init_headless() {
+  DEBBI(debug_graph || debug_init, ("init_headless"));
+  auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+  if(get_platform_display)
+    egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  if(egl_display == EGL_NO_DISPLAY)
+    egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if(egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, nullptr, nullptr)) return false;
+
+  EGLint attribs[] = { EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+  EGLConfig config;
+  EGLint n = 0;
+  if(!eglChooseConfig(egl_display, attribs, &config, 1, &n) || n < 1) return false;
+  if(!eglBindAPI(EGL_OPENGL_API)) return false;
+  egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, nullptr);
+  if(egl_context == EGL_NO_CONTEXT) return false;
+  return eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context);
+  }
+
+EX void close_headless() {
+  if(egl_display == EGL_NO_DISPLAY) return;
+  eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if(egl_context != EGL_NO_CONTEXT) eglDestroyContext(egl_display, egl_context);
+  eglTerminate(egl_display);
+  egl_context = EGL_NO_CONTEXT;
+  egl_display = EGL_NO_DISPLAY;
+  }
+#endif
+
+/** headless replacement for init_graph: no SDL video, the screen size is the requested window size */
+void init_graph_headless() {
+#if CAP_EGL
+  if(!init_headless()) {
+    printf("Failed to initialize headless OpenGL.\n");
+    exit(2);
+    }
+  graphics_on = true;
+  vid.usingGL = true;
+  vid.antialias = vid.want_antialias & ~AA_MULTI;
+  vid.xres = vid.xscr = vid.window_x;
+  vid.yres = vid.yscr = vid.window_y;
+  compute_fsize();
+  #if CAP_SDL
+  if(s) SDL_DestroySurface(s);
+  s_screen = s = shot::empty_surface(vid.xres, vid.yres, false);
+  #endif
+  glViewport(0, 0, vid.xres, vid.yres);
+  glhr::init();
+  resetGL();
+#else
+  printf("Headless rendering is not available in this build (CAP_EGL).\n");
+  exit(2);
+#endif
+  }
+
 #if CAP_SDL
 EX bool sdl_on = false;
 EX bool SDL_Init1(Uint32 flags) {
@@ -1568,6 +1636,7 @@ EX void close_font() {
   }
 
 EX void init_graph() {
+  if(headless) return init_graph_headless();
 #if CAP_SDL
   if (!SDL_Init1(SDL_INIT_VIDEO))
   {
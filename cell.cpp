@@ -247,7 +247,51 @@ EX int dirdiff(int dd, int t) {
 
 EX int cellcount = 0;
 
+#if HDR
+/** \brief dense ids for cells
+ *
+ *  Every cell gets a dense id (gcell::cellid) on creation, and ids of destroyed cells are reused,
+ *  so per-cell scratch data (such as the marks of traversal_workspace) can be kept in plain arrays.
+ *  Cells must be released with destroy_cell, which returns the id.
+ */
+struct cellstore {
+  vector<cell*> cells;
+  vector<int> free_ids;
+  int add(cell *c);
+  void remove(cell *c);
+  void clear();
+  int size() { return isize(cells); }
+  };
+#endif
+
+EX cellstore cell_ids;
+
+int cellstore::add(cell *c) {
+  int id;
+  if(!free_ids.empty()) {
+    id = free_ids.back(); free_ids.pop_back();
+    cells[id] = c;
+    }
+  else {
+    id = isize(cells);
+    cells.push_back(c);
+    }
+  c->cellid = id;
+  return id;
+  }
+
+void cellstore::remove(cell *c) {
+  int id = c->cellid;
+  cells[id] = nullptr;
+  free_ids.push_back(id);
+  }
+
+void cellstore::clear() {
+  cells.clear(); free_ids.clear();
+  }
+
 EX void destroy_cell(cell *c) {
+  cell_ids.remove(c);
   tailored_delete(c);
   cellcount--;
   }
@@ -256,6 +300,7 @@ EX cell *newCell(int type, heptagon *master) {
   cell *c = tailored_alloc<cell> (type);
   c->type = type;
   c->master = master;
+  cell_ids.add(c);
   initcell(c);
   hybrid::will_link(c);
   cellcount++;
@@ -1379,49 +1424,152 @@ EX int heptdistance(cell *c1, cell *c2) {
   else return heptdistance(c1->master, c2->master);
   }
 
-map<pair<cell*, cell*>, int> saved_distances;
+#if HDR
+/** \brief distances from a single source cell, listed in the order of celllister */
+struct distance_table {
+  vector<cell*> cells;
+  vector<int> dists;
+  std::unordered_map<cell*, int> index;
+  /** \brief the parameters of celllister this table was computed with */
+  int max_range, climit;
+  /** \brief true if celllister listed the whole component */
+  bool complete;
+  /** \brief permanent tables are never evicted */
+  bool permanent;
+  std::list<cell*>::iterator lru_pos;
+
+  /** \brief distances to cells outside of the list, computed by bidirectional_celldistance */
+  std::unordered_map<cell*, int> far;
+
+  /** \brief distance to c2, or -1 if not listed */
+  int lookup(cell *c2) {
+    auto it = index.find(c2);
+    return it == index.end() ? -1 : dists[it->second];
+    }
+  int get(cell *c2) {
+    int d = lookup(c2);
+    return d == -1 ? DISTANCE_UNKNOWN : d;
+    }
+  bool covers(int r, int cl) { return complete || (max_range >= r && climit >= cl); }
+  static constexpr size_t entry_size = sizeof(cell*) + sizeof(int) + 4 * sizeof(void*);
+  size_t memory() { return (isize(cells) + isize(far)) * entry_size; }
+  };
+
+/** \brief tables of distances keyed by the source cell, with LRU eviction of the non-permanent ones */
+struct distance_oracle {
+  std::unordered_map<cell*, distance_table> tables;
+  /** \brief most recently used first */
+  std::list<cell*> lru;
+  /** \brief memory used by the non-permanent tables; the permanent ones do not count against distance_memory_limit */
+  size_t temporary_memory = 0;
+  /** \brief incremented when a table is added, removed or made permanent */
+  int version = 0;
+  /** \brief the permanent or complete tables, used as landmarks by bidirectional_celldistance; see get_landmarks */
+  vector<distance_table*> landmarks;
+  int landmarks_version = -1;
+  vector<distance_table*>& get_landmarks();
+  distance_table *find(cell *c1);
+  distance_table& get_table(cell *c1, int max_range, int climit);
+  void erase(cell *c1);
+  void erase_temporary();
+  void clear();
+  };
+#endif
 
-EX set<cell*> keep_distances_from;
+EX distance_oracle saved_distances;
 
-set<cell*> dists_computed;
+/** \brief memory to use for the non-permanent distance tables, in bytes */
+EX size_t distance_memory_limit = 64 << 20;
 
-int perma_distances;
+distance_table *distance_oracle::find(cell *c1) {
+  auto it = tables.find(c1);
+  if(it == tables.end()) return nullptr;
+  auto& t = it->second;
+  if(!t.permanent) lru.splice(lru.begin(), lru, t.lru_pos);
+  return &t;
+  }
+
+void distance_oracle::erase(cell *c1) {
+  auto& t = tables.at(c1);
+  if(!t.permanent) temporary_memory -= t.memory(), lru.erase(t.lru_pos);
+  tables.erase(c1);
+  version++;
+  }
+
+vector<distance_table*>& distance_oracle::get_landmarks() {
+  if(landmarks_version != version) {
+    landmarks.clear();
+    for(auto& p: tables) if(p.second.permanent || p.second.complete) landmarks.push_back(&p.second);
+    landmarks_version = version;
+    }
+  return landmarks;
+  }
+
+distance_table& distance_oracle::get_table(cell *c1, int max_range, int climit) {
+  auto t0 = find(c1);
+  if(t0 && t0->covers(max_range, climit)) return *t0;
+  bool permanent = t0 && t0->permanent;
+  if(t0) erase(c1);
+
+  while(!lru.empty() && temporary_memory > distance_memory_limit) erase(lru.back());
 
-EX void compute_saved_distances(cell *c1, int max_range, int climit) {
-    
   celllister cl(c1, max_range, climit, NULL);
+  auto& t = tables[c1];
+  t.cells = std::move(cl.lst);
+  t.dists = std::move(cl.dists);
+  for(int i=0; i<isize(t.cells); i++) t.index[t.cells[i]] = i;
+  t.max_range = max_range;
+  t.climit = climit;
+  t.complete = cl.reason == celllister::srAll;
+  t.permanent = permanent;
+  if(!permanent) lru.push_front(c1), t.lru_pos = lru.begin(), temporary_memory += t.memory();
+  version++;
+  return t;
+  }
+
+void distance_oracle::erase_temporary() {
+  while(!lru.empty()) erase(lru.back());
+  }
+
+void distance_oracle::clear() {
+  tables.clear(); lru.clear(); temporary_memory = 0;
+  version++;
+  }
 
-  for(int i=0; i<isize(cl.lst); i++)
-    saved_distances[make_pair(c1, cl.lst[i])] = cl.dists[i];
+EX void compute_saved_distances(cell *c1, int max_range, int climit) {
+  saved_distances.get_table(c1, max_range, climit);
   }
 
 EX void permanent_long_distances(cell *c1) {
-  keep_distances_from.insert(c1);
-  if(racing::on)
-    compute_saved_distances(c1, 300, 1000000);
-  else
-    compute_saved_distances(c1, 120, 200000);
+  auto& t = racing::on ? saved_distances.get_table(c1, 300, 1000000) : saved_distances.get_table(c1, 120, 200000);
+  if(!t.permanent) {
+    t.permanent = true;
+    saved_distances.lru.erase(t.lru_pos);
+    saved_distances.temporary_memory -= t.memory();
+    saved_distances.version++;
+    }
   }
 
 EX void erase_saved_distances() {
-  saved_distances.clear(); dists_computed.clear();
-  
-  for(auto c: keep_distances_from) compute_saved_distances(c, 120, 200000);
-  perma_distances = isize(saved_distances);
+  saved_distances.erase_temporary();
   }
 
 EX int max_saved_distance(cell *c) {
-  int maxsd = 0;
-  for(auto& p: saved_distances) if(p.first.first == c) maxsd = max(maxsd, p.second);
-  return maxsd;
+  auto t = saved_distances.find(c);
+  if(!t || t->dists.empty()) return 0;
+  return t->dists.back();
   }
 
 EX cell *random_in_distance(cell *c, int d) {
-  vector<cell*> choices;
-  for(auto& p: saved_distances) if(p.first.first == c && p.second == d) choices.push_back(p.first.second);
-  println(hlog, "choices = ", isize(choices));
-  if(choices.empty()) return NULL;
-  return choices[hrand(isize(choices))];
+  auto t = saved_distances.find(c);
+  if(!t) return NULL;
+  /* dists are sorted, since celllister lists cells in the BFS order */
+  auto lo = std::lower_bound(t->dists.begin(), t->dists.end(), d);
+  auto hi = std::upper_bound(t->dists.begin(), t->dists.end(), d);
+  int choices = hi - lo;
+  println(hlog, "choices = ", choices);
+  if(!choices) return NULL;
+  return t->cells[(lo - t->dists.begin()) + hrand(choices)];
   }
 
 EX int bounded_celldistance(cell *c1, cell *c2) {
@@ -1434,34 +1582,117 @@ EX int bounded_celldistance(cell *c1, cell *c2) {
     }
   #endif
 
-  if(saved_distances.count(make_pair(c1,c2)))
-    return saved_distances[make_pair(c1,c2)];
+  return saved_distances.get_table(c1, 100, limit).get(c2);
+  }
+
+/** \brief the maximum number of cells bidirectional_celldistance may visit before giving up */
+EX int bidir_work_limit = 100000;
 
-  celllister cl(c1, 100, limit, NULL);
-  for(int i=0; i<isize(cl.lst); i++)
-    saved_distances[make_pair(c1, cl.lst[i])] = cl.dists[i];
+/** \brief landmarks for the ALT lower bound: the sources of the permanent or complete distance tables */
+struct landmarks {
+  vector<cell*> sources;
+  vector<distance_table*> tables;
+  /** \brief distances from each landmark to the target */
+  vector<int> to_target;
+  /** \brief saved_distances.version when tables were found; the search generates cells, which may evict or rebuild tables */
+  int version;
 
-  if(saved_distances.count(make_pair(c1,c2)))
-    return saved_distances[make_pair(c1,c2)];
+  landmarks(cell *target) {
+    for(auto t: saved_distances.get_landmarks()) {
+      int d = t->lookup(target);
+      if(d == -1) continue;
+      sources.push_back(t->cells[0]);
+      tables.push_back(t);
+      to_target.push_back(d);
+      }
+    version = saved_distances.version;
+    }
+
+  /** \brief find the tables again, dropping the landmarks whose tables are gone; the distances of a rebuilt table do not change */
+  void refresh() {
+    for(int i=0; i<isize(sources); i++) {
+      auto it = saved_distances.tables.find(sources[i]);
+      if(it != saved_distances.tables.end()) { tables[i] = &it->second; continue; }
+      sources[i] = sources.back(); sources.pop_back();
+      tables[i] = tables.back(); tables.pop_back();
+      to_target[i] = to_target.back(); to_target.pop_back();
+      i--;
+      }
+    version = saved_distances.version;
+    }
 
-  return DISTANCE_UNKNOWN;
+  /** \brief a lower bound on the distance from c to the target, by the triangle inequality */
+  int lower_bound(cell *c) {
+    if(version != saved_distances.version) refresh();
+    int res = 0;
+    for(int i=0; i<isize(tables); i++) {
+      int d = tables[i]->lookup(c);
+      if(d != -1) res = max(res, abs(d - to_target[i]));
+      }
+    return res;
+    }
+  };
+
+/** \brief distance from c1 to c2 by bidirectional BFS, pruned with landmark lower bounds
+ *
+ *  Used for geometries where we have no formula for celldistance. The map is generated as needed,
+ *  so the result is exact; for this reason it should not be used during map generation.
+ *  Returns DISTANCE_UNKNOWN if more than bidir_work_limit cells would have to be visited.
+ */
+EX int bidirectional_celldistance(cell *c1, cell *c2) {
+  if(c1 == c2) return 0;
+  std::unordered_map<cell*, int> dist[2];
+  vector<cell*> frontier[2];
+  int level[2] = {0, 0};
+  landmarks lm[2] = {landmarks(c2), landmarks(c1)};
+  dist[0][c1] = 0; frontier[0].push_back(c1);
+  dist[1][c2] = 0; frontier[1].push_back(c2);
+
+  int best = iteration_limit;
+  int visited = 2;
+  while(!frontier[0].empty() && !frontier[1].empty()) {
+    /* every path not found yet has length at least this */
+    if(level[0] + level[1] + 1 >= best) break;
+    int s = isize(frontier[0]) <= isize(frontier[1]) ? 0 : 1;
+    int d = level[s] + 1;
+    vector<cell*> next;
+    for(cell *c: frontier[s]) forCellCM(c3, c) {
+      if(dist[s].count(c3)) continue;
+      dist[s][c3] = d;
+      visited++;
+      auto it = dist[1-s].find(c3);
+      if(it != dist[1-s].end()) best = min(best, d + it->second);
+      else if(d + lm[s].lower_bound(c3) < best) next.push_back(c3);
+      }
+    if(visited > bidir_work_limit) return DISTANCE_UNKNOWN;
+    frontier[s] = std::move(next);
+    level[s] = d;
+    }
+  return best == iteration_limit ? DISTANCE_UNKNOWN : best;
   }
 
-EX int clueless_celldistance(cell *c1, cell *c2) {
-  if(saved_distances.count(make_pair(c1,c2)))
-    return saved_distances[make_pair(c1,c2)];
-  
-  if(dists_computed.count(c1)) return DISTANCE_UNKNOWN;
-    
-  if(isize(saved_distances) > perma_distances + 1000000) erase_saved_distances();
-  compute_saved_distances(c1, 64, 1000);
-  
- dists_computed.insert(c1);
+/** \brief if true, celldistance in geometries without a formula finds far cells instead of returning DISTANCE_UNKNOWN; see exact_celldistance */
+EX bool want_exact_distances = false;
 
-  if(saved_distances.count(make_pair(c1,c2)))
-    return saved_distances[make_pair(c1,c2)];
-    
-  return DISTANCE_UNKNOWN;
+/** \brief celldistance for geometries without a formula
+ *  @param exact if true and c2 is far away, search for it with bidirectional_celldistance instead of 
+ *  returning DISTANCE_UNKNOWN; this may be expensive and generates the map, so it should not be used during map generation
+ */
+EX int clueless_celldistance(cell *c1, cell *c2, bool exact IS(false)) {
+  auto& t = saved_distances.get_table(c1, 64, 1000);
+  int d = t.lookup(c2);
+  if(d != -1) return d;
+  if(t.complete || !exact) return DISTANCE_UNKNOWN;
+  auto it = t.far.find(c2);
+  if(it != t.far.end()) return it->second;
+  d = bidirectional_celldistance(c1, c2);
+  /* the search generates cells, which may have evicted or rebuilt t */
+  auto t1 = saved_distances.find(c1);
+  if(t1) {
+    t1->far[c2] = d;
+    if(!t1->permanent) saved_distances.temporary_memory += distance_table::entry_size;
+    }
+  return d;
   }
 
 EX int celldistance(cell *c1, cell *c2) {
@@ -1490,7 +1721,7 @@ EX int celldistance(cell *c1, cell *c2) {
     }
 
   if(arcm::in() || quotient || sn::in() || (aperiodic && euclid) || experimental || sl2 || nil || arb::in()) 
-    return clueless_celldistance(c1, c2);
+    return clueless_celldistance(c1, c2, want_exact_distances);
    
    if(S3 >= OINF) return inforder::celldistance(c1, c2);
 
@@ -1513,12 +1744,21 @@ EX int celldistance(cell *c1, cell *c2) {
     // that does not seem to work
     } */
 
-  if(euclid) return clueless_celldistance(c1, c2);
-  if(INVERSE) return clueless_celldistance(c1, c2);
+  if(euclid) return clueless_celldistance(c1, c2, want_exact_distances);
+  if(INVERSE) return clueless_celldistance(c1, c2, want_exact_distances);
 
   return hyperbolic_celldistance(c1, c2);
   }
 
+/** \brief celldistance which does not return DISTANCE_UNKNOWN for far cells in geometries without a formula
+ *
+ *  This searches and generates the map, so it is meant for the user interface and tests, not for map generation.
+ */
+EX int exact_celldistance(cell *c1, cell *c2) {
+  dynamicval<bool> e(want_exact_distances, true);
+  return celldistance(c1, c2);
+  }
+
 EX vector<cell*> build_shortest_path(cell *c1, cell *c2) {
   #if CAP_CRYSTAL
   if(cryst) return crystal::build_shortest_path(c1, c2);
@@ -1586,10 +1826,10 @@ EX void clearCellMemory() {
   currentmap = nullptr; hybrid::pmap = nullptr; fake::pmap = nullptr; gp::pmap = nullptr;
   last_cleared = NULL;
   saved_distances.clear();
-  dists_computed.clear();
-  keep_distances_from.clear(); perma_distances = 0;
   pd_from = NULL;
   gp::gp_adj.clear();
+  if(cellcount == 0) cell_ids.clear();
+  if(tailored_arena.live == 0) tailored_arena.release_all();
   }
 
 auto cellhooks = addHook(hooks_clearmemory, 500, clearCellMemory);
@@ -164,6 +164,81 @@ EX namespace arg {
 EX }
 
 
+#if CAP_FORK
+/** how many jobs started by -fork-jobs may run at the same time */
+EX int fork_jobs_parallel = 1;
+
+/** set once -fork-jobs has run, since a later -fork-parallel would have no effect */
+bool fork_jobs_done = false;
+
+/** split a line of -fork-jobs into arguments: they are separated by spaces or tabs,
+ *  "double quotes" may contain spaces or be empty, and a backslash escapes the next character */
+vector<string> split_job_line(const string& line) {
+  vector<string> res;
+  string cur;
+  bool in_arg = false, quoted = false;
+  for(int i=0; i<isize(line); i++) {
+    char c = line[i];
+    if(c == '\\' && i+1 < isize(line)) { cur += line[++i]; in_arg = true; }
+    else if(c == '"') { quoted = !quoted; in_arg = true; }
+    else if(!quoted && (c == ' ' || c == '\t')) {
+      if(in_arg) res.push_back(cur);
+      cur = ""; in_arg = false;
+      }
+    else { cur += c; in_arg = true; }
+    }
+  if(quoted) throw hr_exception("unterminated quote in -fork-jobs line: " + line);
+  if(in_arg) res.push_back(cur);
+  return res;
+  }
+
+/** run every line of fname as a separate list of command line arguments (see split_job_line), in a child process forked from this one;
+ *  the children inherit the geometry and the shapes built so far, so they do not have to build them again;
+ *  a job fails if it exits with a non-zero status, including when it throws;
+ *  the children would share the window and the OpenGL (or EGL) context of the parent, so this refuses to run once graphics are on (use -nogui) */
+EX void fork_jobs(const string& fname) {
+  if(graphics_on) throw hr_exception("-fork-jobs cannot fork a process with a live window or OpenGL context; use -nogui");
+  fhstream f(fname, "rt");
+  if(!f.f) return file_error(fname);
+  start_game();
+  if(currentmap) cgi.require_shapes();
+  fflush(stdout); fflush(stderr);
+  int running = 0, failed = 0, total = 0;
+  auto wait_one = [&] {
+    int status;
+    if(wait(&status) <= 0) { running = 0; return; }
+    running--;
+    if(!WIFEXITED(status) || WEXITSTATUS(status)) failed++;
+    };
+  while(!feof(f.f)) {
+    string line = scanline_noblank(f);
+    if(line == "" || line[0] == '#') continue;
+    vector<string> job;
+    try { job = split_job_line(line); }
+    catch(hr_exception& e) { println(hlog, "fork-jobs: ", e.what()); failed++; total++; continue; }
+    while(running >= fork_jobs_parallel) wait_one();
+    pid_t pid = fork();
+    if(pid < 0) throw hr_exception("fork failed");
+    if(pid == 0) {
+      int code = 0;
+      try {
+        arg::run_arguments(job);
+        }
+      catch(std::exception& e) {
+        println(hlog, "fork-jobs: job '", line, "' failed: ", e.what());
+        code = 1;
+        }
+      fflush(stdout); fflush(stderr);
+      _exit(code);
+      }
+    running++; total++;
+    }
+  while(running) wait_one();
+  fork_jobs_done = true;
+  println(hlog, "fork-jobs: ", total, " jobs, ", failed, " failed");
+  }
+#endif
+
 int arg::readCommon() {
 
 // first phase options
@@ -172,6 +247,7 @@ int arg::readCommon() {
   else if(argis("-no-s")) { PHASE(2); scorefile = ""; savefile_selection = false; }
   else if(argis("-rsrc")) { PHASE(1); shift(); rsrcdir = args(); }
   else if(argis("-nogui")) { PHASE(1); noGUI = true; }
+  else if(argis("-headless")) { PHASE(1); headless = true; }
 #ifndef EMSCRIPTEN
 #if CAP_SDLTTF
   else if(argis("-font")) { PHASE(1); shift(); font_id = isize(font_filenames); font_filenames.push_back(args()); font_names.push_back({args(), "commandline"}); }
@@ -215,6 +291,15 @@ int arg::readCommon() {
   else if(argis("-draw")) {
     PHASE(3); start_game(); drawscreen();
     }
+#if CAP_FORK
+  else if(argis("-fork-jobs")) {
+    PHASE(3); shift(); fork_jobs(args());
+    }
+  else if(argis("-fork-parallel")) {
+    if(fork_jobs_done) throw hr_exception("-fork-parallel must be given before -fork-jobs");
+    shift(); fork_jobs_parallel = max(argi(), 1);
+    }
+#endif
   else if(argis("-sview")) {
     PHASE(3);  start_game();
     playermoved = false;
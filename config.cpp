@@ -1273,6 +1273,10 @@ EX void initConfig() {
   
   param_b(vid.wantGL, "usingGL", true)
   ->editable("openGL mode", 'o');
+  #if CAP_GL
+  param_b(batch_polygons, "batch_polygons")
+  ->help("Merge consecutive convex polygons into a single OpenGL draw call. Helps on software OpenGL.");
+  #endif
   
   param_i(vid.want_antialias, "antialias", AA_NOGL | AA_FONT | (ISWEB ? AA_MULTI : AA_LINES) | AA_VERSION);
   param_b(vid.fineline, "fineline", true)->help("Disable this to make all line widths 1.");
@@ -1467,6 +1471,7 @@ EX void initConfig() {
 
   param_b(memory_saving_mode, "memory_saving_mode", (ISMOBILE || ISPANDORA || ISWEB) ? 1 : 0);
   param_i(reserve_limit, "memory_reserve", 128);
+  param_i(bidir_work_limit, "bidir_work_limit");
   param_b(show_memory_warning, "show_memory_warning");
 
   param_b(rug::renderonce, "rug-renderonce");
@@ -1548,6 +1553,7 @@ EX void initConfig() {
   // modes
     
   param_b(shmup::on, "mode-shmup", false)->be_non_editable();
+  param_i(shmup::collision_cell_range, "shmup_collision_range");
   param_b(hardcore, "mode-hardcore", false)->set_reaction([] { hardcore = !hardcore; switchHardcore_quiet(); });
   param_enum(land_structure, "mode-chaos", lsNiceWalls)->be_non_editable();
   #if CAP_INV
@@ -1645,6 +1651,8 @@ EX void initConfig() {
   #if CAP_SOLV
   param_f(sn::solrange_xy, "solrange-xy");
   param_f(sn::solrange_z, "solrange-z");
+  param_i(sn::geodesic_table_resolution, "geodesic_table_resolution")
+  ->set_reaction([] { sn::solt.release(); sn::niht.release(); sn::sont.release(); });
   #endif
   param_i(slr::shader_iterations, "slr-steps");
   param_f(slr::range_xy, "slr-range-xy");
@@ -1726,6 +1734,12 @@ EX void initConfig() {
   ->help("Do not draw if their distance is greater than the sight range (although some points might be closer). This is faster.");
 
   param_i(vid.texture_step, "wall-quality", 4);
+  param_i(cgi_cache_limit, "cgi_cache_limit", 3)
+  -> editable(0, 16, 1, "geometries kept in memory",
+    "Shapes of this many recently used geometries are kept in memory, so that switching back to them is instant. Larger values use more memory.",
+    'G')
+  -> set_sets([] { dialog::bound_low(0); });
+  param_i(shapes_progress_delay, "shapes_progress_delay", 500);
   add_texture_params();
   
   param_b(smooth_scrolling, "smooth-scrolling", false)
@@ -432,7 +432,7 @@ struct debugScreen {
         dialog::addSelItem("pointer", s0+hr::format("%p", hr::voidp(what))+"/"+index_pointer(what), 0);
         dialog::addSelItem("cpdist", its(what->cpdist), 0);
         dialog::addSelItem("celldist", its(celldist(what)), 0);
-        dialog::addSelItem("celldistance", its(celldistance(cwt.at, what)), 0);
+        dialog::addSelItem("celldistance", its(exact_celldistance(cwt.at, what)), 0);
         dialog::addSelItem("pathdist", its(what->pathdist), 0);
         dialog::addSelItem("celldistAlt", eubinary ? its(celldistAlt(what)) : "--", 0);
         dialog::addSelItem("temporary", its(what->listindex), 0);
@@ -601,7 +601,7 @@ void test_distances(int max) {
   int ok = 0, bad = 0;
   celllister cl(cwt.at, max, 100000, NULL);
   for(cell *c: cl.lst) {
-    bool is_ok = cl.getdist(c) == celldistance(c, cwt.at);
+    bool is_ok = cl.getdist(c) == exact_celldistance(c, cwt.at);
     if(is_ok) ok++; else bad++;
     }
   println(hlog, "ok=", ok, " bad=", bad);
@@ -15,7 +15,15 @@
 
 // By default this generates 64x64x64 tables.
 // Add e.g. '-dim 128 128 128' before -write to generate
-// a more/less precise table.
+// a more/less precise table. Tables written as e.g. solv-geodesics-128.dat
+// are used instead of the default ones when geodesic_table_resolution is 128.
+
+// For long runs, add '-checkpoint [filename]' before -build or -improve:
+// the table and the list of finished z-slices are saved every
+// '-checkpoint-interval' seconds (300 by default), to [filename].build
+// or [filename].improve, and '-resume' continues each phase from its own
+// checkpoint. '-build-threads N' sets the number of threads (all cores by
+// default). -write also writes the per-slice errors to [filename].stats.
 
 // # ./hyper -rk-steps 100 -geo Sol -iz-list -sn-unittest -build -write solv-geodesics-a.dat -visualize devmods/san1/solva-%04d.png -improve -write solv-geodesics.dat -visualize devmods/san1/solvb-%04d.png
 // # ./hyper -dim 32 32 32 -geo 3:1/2 -iz-list -sn-unittest -build -write ssol-geodesics-a.dat -visualize devmods/san1/ssola-%04d.png -improve -write ssol-geodesics.dat -visualize devmods/san1/ssolb-%04d.png
@@ -25,6 +33,7 @@
 
 #include <thread>
 #include <mutex>
+#include <atomic>
 
 namespace hr {
 
@@ -32,14 +41,6 @@ transmatrix parabolic1(ld u);
 
 namespace sn {
 
-template<class T> void parallelize(int threads, int Nmin, int Nmax, T action) {
-  std::vector<std::thread> v;
-  for(int k=0; k<threads; k++)
-    v.emplace_back([&,k] () { 
-      for(int i=Nmin+k; i < Nmax; i += threads) action(k, i);
-      });
-  for(std::thread& t:v) t.join();
-  }
 
 ld solerror(hyperpoint ok, hyperpoint chk) {
   auto zok  = point3( x_to_ix(ok[0]), x_to_ix(ok[1]), z_to_iz(ok[2]) );
@@ -147,23 +148,146 @@ ptlow operator +(ptlow a, ptlow b) { return make_array<float>(a[0]+b[0], a[1]+b[
 ptlow operator -(ptlow a, ptlow b) { return make_array<float>(a[0]-b[0], a[1]-b[1], a[2]-b[2]); }
 ptlow operator *(ptlow a, ld x) { return make_array<float>(a[0]*x, a[1]*x, a[2]*x); }
 
-void fint(FILE *f, int x) { fwrite(&x, sizeof(x), 1, f); }
-void ffloat(FILE *f, float x) { fwrite(&x, sizeof(x), 1, f); }
 
 void write_table(sn::tabled_inverses& tab, const char *fname) {
-  FILE *f = fopen(fname, "wb");
-  fint(f, tab.PRECX);
-  fint(f, tab.PRECY);
-  fint(f, tab.PRECZ);
-  fwrite(&tab.tab[0], sizeof(ptlow) * tab.PRECX * tab.PRECY * tab.PRECZ, 1, f);
-  fclose(f);
+  tab.save(fname);
   }
 
 void alloc_table(sn::tabled_inverses& tab, int X, int Y, int Z) {
-  tab.PRECX = X;
-  tab.PRECY = Y;
-  tab.PRECZ = Z;
-  tab.tab.resize(X*Y*Z);
+  tab.alloc(X, Y, Z);
+  }
+
+/** error statistics of a z-slice */
+struct slice_stats {
+  int points = 0, failures = 0;
+  ld max_err = 0, total_err = 0;
+  bool done = false;
+  void add(ld err) { points++; total_err += err; max_err = max(max_err, err); }
+  };
+
+vector<slice_stats> stats;
+
+/** if non-empty, the table and the list of finished slices are saved there from time to time */
+string checkpoint_file;
+
+/** how often to save the checkpoint, in seconds */
+int checkpoint_interval = 300;
+
+/** continue from checkpoint_file */
+bool resume = false;
+
+/** 0 = use all the cores */
+int build_threads = 0;
+
+/** the checkpoint of the given phase ("build" or "improve"); the phases have separate checkpoints,
+ *  since a finished build would otherwise make -resume skip all the slices of improve */
+string phase_checkpoint(const string& what) {
+  return checkpoint_file + "." + what;
+  }
+
+/** must not run while the threads of run_slices are changing the table */
+void save_checkpoint(sn::tabled_inverses& tab, const string& what) {
+  if(checkpoint_file == "") return;
+  string fname = phase_checkpoint(what);
+  string tmp = fname + ".tmp";
+  tab.save(tmp);
+  rename(tmp.c_str(), fname.c_str());
+  FILE *f = fopen((fname + ".done").c_str(), "wt");
+  if(!f) return;
+  for(int iz=0; iz<isize(stats); iz++) if(stats[iz].done) {
+    auto& s = stats[iz];
+    fprintf(f, "%d %d %d %.10g %.10g\n", iz, s.points, s.failures, double(s.max_err), double(s.total_err));
+    }
+  fclose(f);
+  }
+
+/** load the checkpoint of the given phase, if resuming; returns true if it has been loaded */
+bool load_checkpoint(sn::tabled_inverses& tab, const string& what, int X, int Y, int Z) {
+  stats.assign(Z, slice_stats());
+  if(!resume || checkpoint_file == "") return false;
+  string fname = phase_checkpoint(what);
+  sn::tabled_inverses chk(fname);
+  if(!chk.load_from(fname) || chk.PRECX != X || chk.PRECY != Y || chk.PRECZ != Z) {
+    chk.release();
+    println(hlog, "no usable checkpoint in ", fname);
+    return false;
+    }
+  alloc_table(tab, X, Y, Z);
+  for(int i=0; i<X*Y*Z; i++) tab.tab[i] = chk.data[i];
+  chk.release();
+  FILE *f = fopen((fname + ".done").c_str(), "rt");
+  if(f) {
+    int iz, points, failures; double max_err, total_err;
+    while(fscanf(f, "%d%d%d%lf%lf", &iz, &points, &failures, &max_err, &total_err) == 5) if(iz >= 0 && iz < Z) {
+      auto& s = stats[iz];
+      s.points = points; s.failures = failures; s.max_err = max_err; s.total_err = total_err; s.done = true;
+      }
+    fclose(f);
+    }
+  int done = 0;
+  for(auto& s: stats) if(s.done) done++;
+  println(hlog, "resuming from ", fname, ": ", done, "/", Z, " slices done");
+  return true;
+  }
+
+/** run act(iz, stats) for all the z-slices which are not done yet; the threads take the next free slice when they finish one
+ *
+ *  When a checkpoint is due, the threads stop taking new slices; the checkpoint is saved after they all have finished
+ *  their current slices and joined, and then the work continues.
+ */
+template<class T> void run_slices(sn::tabled_inverses& tab, const string& what, T act) {
+  int PRECZ = tab.PRECZ;
+  if(isize(stats) != PRECZ) stats.assign(PRECZ, slice_stats());
+  int threads = build_threads ? build_threads : max<int>(std::thread::hardware_concurrency(), 1);
+
+  std::atomic<int> next(0);
+  std::mutex stats_mutex;
+  int todo = 0, finished = 0;
+  long long points = 0;
+  for(auto& s: stats) if(!s.done) todo++;
+  time_t start = time(NULL), last_checkpoint = start;
+  std::atomic<bool> checkpoint_due(false);
+
+  while(next < PRECZ) {
+    checkpoint_due = false;
+    std::vector<std::thread> v;
+    for(int k=0; k<threads; k++)
+      v.emplace_back([&] () {
+        while(!checkpoint_due) {
+          int iz = next++;
+          if(iz >= PRECZ) return;
+          if(stats[iz].done) continue;
+          slice_stats s;
+          act(iz, s);
+          s.done = true;
+
+          std::lock_guard<std::mutex> lock(stats_mutex);
+          stats[iz] = s;
+          finished++; points += s.points;
+          time_t now = time(NULL);
+          ld elapsed = max<ld>(now - start, 1);
+          println(hlog, what, ": slice ", iz, " done (", finished, "/", todo, "), max error ", s.max_err, ", ", s.failures, " failures; ",
+            int(points / elapsed), " points/s, ETA ", int(elapsed * (todo - finished) / finished), " s");
+          if(checkpoint_file != "" && now - last_checkpoint >= checkpoint_interval) checkpoint_due = true;
+          }
+        });
+    for(std::thread& t:v) t.join();
+    save_checkpoint(tab, what);
+    last_checkpoint = time(NULL);
+    }
+  }
+
+/** write the per-slice error statistics next to the table */
+void write_stats(const string& fname) {
+  FILE *f = fopen(fname.c_str(), "wt");
+  if(!f) return;
+  fprintf(f, "# iz points failures max_error mean_error\n");
+  for(int iz=0; iz<isize(stats); iz++) {
+    auto& s = stats[iz];
+    if(!s.done) continue;
+    fprintf(f, "%d %d %d %.10g %.10g\n", iz, s.points, s.failures, double(s.max_err), s.points ? double(s.total_err / s.points) : 0.);
+    }
+  fclose(f);
   }
 
 ld ptd(ptlow p) {
@@ -197,9 +321,10 @@ void build_sols(int PRECX, int PRECY, int PRECZ) {
   std::mutex file_mutex;
   ld max_err = 0;
   auto& tab = sn::get_tabled();
-  alloc_table(tab, PRECX, PRECY, PRECZ);
+  if(!load_checkpoint(tab, "build", PRECX, PRECY, PRECZ))
+    alloc_table(tab, PRECX, PRECY, PRECZ);
   int last_x = PRECX-1, last_y = PRECY-1, last_z = PRECZ-1;
-  auto act = [&] (int tid, int iz) {
+  auto act = [&] (int iz, slice_stats& stat) {
     if((nih && iz == 0) || iz == PRECZ-1) return;
   
     auto solve_at = [&] (int ix, int iy) {
@@ -236,9 +361,11 @@ void build_sols(int PRECX, int PRECY, int PRECZ) {
       
       if(cand == fail) {
         println(hlog, hr::format("[%2d %2d %2d] FAIL", iz, iy, ix));
+        stat.failures++;
         }
       
       else if(xerr > 1e-3) {
+        stat.failures++;
         println(hlog, hr::format("[%2d %2d %2d] ", iz, iy, ix));
         println(hlog, "f(?) = ", v);
         println(hlog, "f(", cand, ") = ", nisot::numerical_exp(cand));
@@ -251,6 +378,7 @@ void build_sols(int PRECX, int PRECY, int PRECZ) {
       auto& so = tab.get_int(ix, iy, iz);
       
       so = compress(azeq_to_table(cand));
+      stat.add(xerr);
 
       for(int z=0; z<3; z++) if(isnan(so[z]) || isinf(so[z])) {
         println(hlog, cand, "canned to ", so);
@@ -269,7 +397,7 @@ void build_sols(int PRECX, int PRECY, int PRECZ) {
       }
     };
 
-  parallelize(PRECZ, 0, PRECZ, act);
+  run_slices(tab, "build", act);
   
   fix_boundaries(tab, last_x, last_y, last_z);
   }
@@ -478,9 +606,10 @@ void improve(sn::tabled_inverses& tab) {
   int PRECY = tab.PRECY;
   int PRECZ = tab.PRECZ;
   int last_x = PRECX-1, last_y = PRECY-1, last_z = PRECZ-1;
+  load_checkpoint(tab, "improve", PRECX, PRECY, PRECZ);
 
   max_iter = 1000;
-  auto act = [&] (int tid, int iz) {
+  auto act = [&] (int iz, slice_stats& stat) {
     if((nih && iz == 0) || iz == PRECZ-1) return;
     for(int iy=0; iy<last_y; iy++)
     for(int ix=0; ix<last_x; ix++) {
@@ -500,12 +629,14 @@ void improve(sn::tabled_inverses& tab) {
       if(h2 != fail) {
         auto& so = tab.get_int(ix, iy, iz);
         so = compress(azeq_to_table(h2)); 
+        stat.add(solerror(p, nisot::numerical_exp(h2)));
         }
+      else stat.failures++;
       }
     };
   max_iter = 1000000;
   
-  parallelize(PRECZ, 0, PRECZ, act);
+  run_slices(tab, "improve", act);
   if(deb) exit(7);
 
 
@@ -535,14 +666,29 @@ int readArgs() {
     }
   else if(argis("-improve")) {
     sn::get_tabled().load();
+    sn::get_tabled().make_writable();
     improve(sn::get_tabled());
     }
   else if(argis("-write")) {
     shift();
     write_table(sn::get_tabled(), argcs());
+    if(isize(stats)) write_stats(args() + ".stats");
+    }
+  else if(argis("-checkpoint")) {
+    shift(); checkpoint_file = args();
+    }
+  else if(argis("-checkpoint-interval")) {
+    shift(); checkpoint_interval = argi();
+    }
+  else if(argis("-resume")) {
+    resume = true;
+    }
+  else if(argis("-build-threads")) {
+    shift(); build_threads = argi();
     }
   else if(argis("-fix-bugs")) {
     sn::get_tabled().load();
+    sn::get_tabled().make_writable();
     fix_bugs(sn::get_tabled());
     }
   else if(argis("-iz-list")) {
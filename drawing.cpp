@@ -48,7 +48,12 @@ static constexpr flagtype POLY_FORCE_DEPTH = Flag(31);    // always depth test
  *  which store the data to draw in hr::ptds. This approach lets us draw the elements in the correct order. 
  */
 
+extern slab_arena drawitem_arena;
+
 struct drawqueueitem {
+  /** \brief Items are created and destroyed every frame, so they are kept in drawitem_arena. Sizes are rounded to 16 for long double alignment. */
+  static void *operator new(size_t s) { return drawitem_arena.alloc((s + 15) & ~15); }
+  static void operator delete(void *p, size_t s) { drawitem_arena.free(p, (s + 15) & ~15); }
   /** \brief The higher the priority, the earlier we should draw this object. */
   PPR prio;
   /** \brief Color of this object. */
@@ -163,6 +168,9 @@ bool fatborder;
 
 EX color_t poly_outline;
 
+/** \brief the memory for drawqueueitems; freed items are reused in the next frame (defined before ptds, which is destroyed first) */
+slab_arena drawitem_arena;
+
 EX vector<unique_ptr<drawqueueitem>> ptds;
 
 #if CAP_GL
@@ -172,16 +180,27 @@ EX GLuint text_texture;
 EX int texts_merged;
 EX int shapes_merged;
 
-#if MINIMIZE_GL_CALLS
+/** \brief merge consecutive untextured convex polygons (and their outlines) into one vertex stream, drawn with a single call
+ *
+ *  Vertex colors are used, so polygons of different colors can be merged; the stream is flushed whenever the priority
+ *  or the shift changes, or a polygon which cannot be merged comes, so the painter's order is kept.
+ */
+EX bool batch_polygons = MINIMIZE_GL_CALLS;
+
 PPR lprio;
 ld m_shift;
 vector<glhr::colored_vertex> triangle_vertices;
 vector<glhr::colored_vertex> line_vertices;
-#endif
+
+/** the depth and fog state of the merged polygons, which depends only on their priority, as in dqi_poly::gldraw */
+void set_batch_state() {
+  glhr::set_depthtest(model_needs_depth() && lprio < PPR::SUPERLINE);
+  glhr::set_depthwrite(model_needs_depth() && lprio != PPR::TRANSPARENT_SHADOW && lprio != PPR::EUCLIDEAN_SKY);
+  glhr::set_fogbase(lprio == PPR::SKY ? 1.0 + (euclid ? 20 : 5 / sightranges[geometry]) : 1.0);
+  }
 
 EX void glflush() {
   DEBBI(debug_graph, ("glflush"));
-  #if MINIMIZE_GL_CALLS
   if(isize(triangle_vertices)) {
     // printf("%3d | %d shapes, %d/%d vertices\n", lprio, shapes_merged, isize(triangle_vertices), isize(line_vertices));
     current_display->next_shader_flags = GF_VARCOLOR;
@@ -189,6 +208,7 @@ EX void glflush() {
     if(true) {
       glhr::be_nontextured();
       glapplymatrix(Id);
+      set_batch_state();
       glhr::current_vertices = NULL;
       glhr::prepare(triangle_vertices);
       glhr::color2(0xFFFFFFFF);
@@ -204,6 +224,7 @@ EX void glflush() {
     if(true) {
       glhr::be_nontextured();
       glapplymatrix(Id);
+      set_batch_state();
       glhr::current_vertices = NULL;
       glhr::prepare(line_vertices);
       glhr::color2(0xFFFFFFFF);
@@ -212,7 +233,6 @@ EX void glflush() {
     line_vertices.clear();
     }
   shapes_merged = 0;
-  #endif
   
   if(isize(text_vertices)) {
     current_display->next_shader_flags = GF_TEXTURE;
@@ -516,6 +536,17 @@ void addpoly(const shiftmatrix& V, const vector<glvertex> &tab, int ofs, int cnt
   tofix.clear(); knowgood = false;
   if(in_perspective()) {
     if(get_shader_flags() & SF_SEMIDIRECT) {
+      #if CAP_SOLV
+      if(pmodel == mdGeodesic && sn::in() && cnt) {
+        /* the rest is done on the GPU in single precision anyway */
+        static vector<hyperpoint> pts, res;
+        pts.resize(cnt); res.resize(cnt);
+        for(int i=0; i<cnt; i++) pts[i] = V.T * glhr::gltopoint(tab[ofs+i]);
+        sn::get_inverse_exp_batch(cnt, &pts[0], &res[0], pfNO_DISTANCE | pfFLOAT_TABLES);
+        for(auto& h: res) { h[3] = 1; add1(h); }
+        return;
+        }
+      #endif
       dynamicval<bool> d(computing_semidirect, true);
       for(int i=ofs; i<ofs+cnt; i++) {
         hyperpoint Hscr;
@@ -679,8 +710,9 @@ void dqi_poly::gldraw() {
   auto& v = *tab;
   int ioffset = offset;
   
-#if MINIMIZE_GL_CALLS  
-  if(current_display->separate_eyes() == 0 && !tinf && (color == 0 || ((flags & (POLY_VCONVEX | POLY_CCONVEX)) && !(flags & (POLY_INVERSE | POLY_FORCE_INVERTED))))) {
+  /* polygons which need their own shader, depth or blending state are never merged */
+  bool mergeable = !tinf && !(flags & (POLY_TRIANGLES | POLY_NO_FOG | POLY_FORCE_DEPTH | POLY_INTENSE)) && !sl2 && min_slr >= max_slr;
+  if(batch_polygons && mergeable && current_display->separate_eyes() == 0 && (color == 0 || ((flags & (POLY_VCONVEX | POLY_CCONVEX)) && !(flags & (POLY_INVERSE | POLY_FORCE_INVERTED))))) {
     if(lprio != prio || texts_merged || m_shift != V.shift) {
       glflush();
       lprio = prio;
@@ -688,8 +720,9 @@ void dqi_poly::gldraw() {
       }
     shapes_merged++;
 
+    static vector<glhr::colored_vertex> v2;
     if((flags & POLY_CCONVEX) && !(flags & POLY_VCONVEX)) {
-      vector<glhr::colored_vertex> v2(cnt+1);
+      v2.resize(cnt+1);
       for(int i=0; i<cnt+1; i++) v2[i] = glhr::colored_vertex( V.T * glhr::gltopoint( v[offset+i-1] ), color);
       if(color) for(int i=0; i<cnt; i++) triangle_vertices.push_back(v2[0]), triangle_vertices.push_back(v2[i]), triangle_vertices.push_back(v2[i+1]);
       if(outline) {
@@ -698,7 +731,7 @@ void dqi_poly::gldraw() {
         }
       }
     else {
-      vector<glhr::colored_vertex> v2(cnt);
+      v2.resize(cnt);
       for(int i=0; i<cnt; i++) v2[i] = glhr::colored_vertex( V.T * glhr::gltopoint( v[offset+i] ), color);
       if(color) for(int i=2; i<cnt-1; i++) triangle_vertices.push_back(v2[0]), triangle_vertices.push_back(v2[i-1]), triangle_vertices.push_back(v2[i]);
       if(outline) {
@@ -708,8 +741,7 @@ void dqi_poly::gldraw() {
       }
     return;
     }
-  else glflush();
-#endif
+  else if(batch_polygons) glflush();
   
   if(tinf) {
     bool col = isize(tinf->colors);
@@ -909,10 +941,8 @@ EX ld linewidthat(const shiftpoint& h) {
   }
 
 EX void set_width(ld w) {
-  #if MINIMIZE_GL_CALLS
-  if(w != glhr::current_linewidth) glflush();
-  #endif
   #if CAP_GL
+  if(batch_polygons && w != glhr::current_linewidth) glflush();
   glhr::set_linewidth(w);
   #endif
   }
@@ -2353,15 +2383,18 @@ EX void sort_drawqueue() {
   
   int siz = isize(ptds);
 
-  #if MINIMIZE_GL_CALLS
-  map<color_t, vector<unique_ptr<drawqueueitem>>> subqueue;
-  for(auto& p: ptds) subqueue[(p->prio == PPR::CIRCLE || p->prio == PPR::OUTCIRCLE) ? 0 : p->outline_group()].push_back(std::move(p));
-  ptds.clear();
-  for(auto& p: subqueue) for(auto& r: p.second) ptds.push_back(std::move(r));
-  subqueue.clear();
-  for(auto& p: ptds) subqueue[(p->prio == PPR::CIRCLE || p->prio == PPR::OUTCIRCLE) ? 0 : p->color].push_back(std::move(p));
-  ptds.clear();
-  for(auto& p: subqueue) for(auto& r: p.second) ptds.push_back(std::move(r));
+  #if CAP_GL
+  /* group by color, so that more polygons can be merged */
+  if(batch_polygons) {
+    map<color_t, vector<unique_ptr<drawqueueitem>>> subqueue;
+    for(auto& p: ptds) subqueue[(p->prio == PPR::CIRCLE || p->prio == PPR::OUTCIRCLE) ? 0 : p->outline_group()].push_back(std::move(p));
+    ptds.clear();
+    for(auto& p: subqueue) for(auto& r: p.second) ptds.push_back(std::move(r));
+    subqueue.clear();
+    for(auto& p: ptds) subqueue[(p->prio == PPR::CIRCLE || p->prio == PPR::OUTCIRCLE) ? 0 : p->color].push_back(std::move(p));
+    ptds.clear();
+    for(auto& p: subqueue) for(auto& r: p.second) ptds.push_back(std::move(r));
+    }
   #endif
     
   for(auto& p: ptds) {
@@ -2379,11 +2412,13 @@ EX void sort_drawqueue() {
     qp0[a] = qp[a] = total; total += b;
     }
 
-  vector<unique_ptr<drawqueueitem>> ptds2;  
+  /* kept between frames, to avoid reallocating */
+  static vector<unique_ptr<drawqueueitem>> ptds2;
   ptds2.resize(siz);
   
   for(int i = 0; i<siz; i++) ptds2[qp[int(ptds[i]->prio)]++] = std::move(ptds[i]);
   swap(ptds, ptds2);
+  ptds2.clear();
   }
 
 EX void reverse_priority(PPR p) {
@@ -161,21 +161,79 @@ EX void compute_graphical_distance() {
   pathlock--;
   }
 
-const int max_radius = 16;
+#if HDR
+/** \brief reusable scratch space for the per-turn traversals
+ *
+ *  Marks are stamped with a generation number and indexed by gcell::cellid, so clearing
+ *  them all between traversals is O(1). The queues keep their capacity between turns.
+ *  Only one traversal may use the workspace at a time.
+ */
+struct traversal_workspace {
+  vector<unsigned> stamp, bits;
+  unsigned generation = 0;
+  vector<vector<cell*>> queues;
+  /** \brief start a new traversal, clearing all the marks */
+  void reset();
+  /** \brief the mark bits of c in the current traversal */
+  unsigned& marks(cell *c);
+  /** \brief set the given mark bit of c; return false if it was already set */
+  bool mark(cell *c, int bit IS(0));
+  /** \brief make sure that queues 0..n-1 exist; references to them stay valid until the next call with a larger n */
+  void reserve_queues(int n);
+  /** \brief the i-th queue, emptied; reserve_queues(i+1) must have been called */
+  vector<cell*>& fresh_queue(int i);
+  };
+#endif
 
-struct visit_set {
-  set<cell*> visited;
-  queue<cell*> q;
-  void visit(cell *c) {
-    if(visited.count(c)) return;
-    visited.insert(c);
-    q.push(c);
+EX traversal_workspace tws;
+
+void traversal_workspace::reset() {
+  generation++;
+  if(generation == 0) {
+    for(auto& s: stamp) s = 0;
+    generation = 1;
     }
-  };
+  }
+
+unsigned& traversal_workspace::marks(cell *c) {
+  int id = c->cellid;
+  if(id >= isize(stamp)) {
+    stamp.resize(cell_ids.size(), 0);
+    bits.resize(cell_ids.size());
+    }
+  if(stamp[id] != generation) stamp[id] = generation, bits[id] = 0;
+  return bits[id];
+  }
+
+bool traversal_workspace::mark(cell *c, int bit) {
+  unsigned& m = marks(c);
+  if(m & (1u << bit)) return false;
+  m |= (1u << bit);
+  return true;
+  }
+
+void traversal_workspace::reserve_queues(int n) {
+  if(n > isize(queues)) queues.resize(n);
+  }
 
+vector<cell*>& traversal_workspace::fresh_queue(int i) {
+  queues[i].clear();
+  return queues[i];
+  }
+
+const int max_radius = 16;
+
+/** the Princess AI: cells in distance k from a closed gate are on the k-th queue of tws, and have the k-th mark bit */
 struct princess_ai {
-  array<visit_set, max_radius+1> info;
-  void visit_gate(cell *g) { info[0].visit(g); }
+  array<vector<cell*>*, max_radius+1> q;
+  array<int, max_radius+1> head;
+  princess_ai() {
+    tws.reset();
+    tws.reserve_queues(max_radius+1);
+    for(int k=0; k<=max_radius; k++) q[k] = &tws.fresh_queue(k), head[k] = 0;
+    }
+  void visit(int k, cell *c) { if(tws.mark(c, k)) q[k]->push_back(c); }
+  void visit_gate(cell *g) { visit(0, g); }
   void run();
   };
 
@@ -188,13 +246,12 @@ void princess_ai::run() {
   if(d < 5) d = 5; /* the Princess AI avoids plates when too close to the player */
   hassert(radius <= max_radius);
 
-  for(int k=0; k<=radius; k++) while(!info[k].q.empty()) {
-    cell *c = info[k].q.front();
-    info[k].q.pop();
+  for(int k=0; k<=radius; k++) while(head[k] < isize(*q[k])) {
+    cell *c = (*q[k])[head[k]++];
     if(k < radius) forCellEx(c1, c) {
-      info[k+1].visit(c1);
+      visit(k+1, c1);
       if(k == 0 && c1->wall == waClosedGate)
-        info[0].visit(c1);
+        visit(0, c1);
       }
     if(k == radius && c->wall == waOpenPlate && c->pathdist == PINFD)
       onpath_random_dir(c, d);
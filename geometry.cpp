@@ -1445,6 +1445,9 @@ EX string cgi_string() {
 #define IFINTRA(x,y) y
 #endif
 
+/** how many unused geometry_information objects are kept; switching back to one of them does not need to rebuild the shapes */
+EX int cgi_cache_limit = 3;
+
 EX void check_cgi() {
   string s = cgi_string();
   
@@ -1457,7 +1460,7 @@ EX void check_cgi() {
   if(arcm::alt_cgip[1]) arcm::alt_cgip[1]->timestamp = ntimestamp;
   #endif
   
-  int limit = 3;
+  int limit = cgi_cache_limit;
   for(auto& t: cgis) if(t.second.use_count || t.second.timestamp == ntimestamp) limit++;
   if(isize(cgis) > limit) {
     vector<pair<int, string>> timestamps;
@@ -64,6 +64,7 @@ EX purehookset hooks_frame, hooks_markers;
 int colorbar;
 
 EX bool inHighQual; // taking high quality screenshot
+EX bool in_drawscreen; // drawscreen is running
 EX bool auraNOGL;    // aura without GL
 
 // 
@@ -1918,6 +1919,7 @@ EX color_t titlecolor;
 EX void drawscreen() {
 
   indenter_finish(debug_map, "drawscreen");
+  dynamicval<bool> ids(in_drawscreen, true);
   #if CAP_GL
   GLWRAP;
   #endif
@@ -529,6 +529,8 @@ public:
         map_->erase(prio);
         }
 
+    bool empty() const { return map_ == nullptr || map_->empty(); }
+
     template<class... U>
     void callhooks(U&&... args) const {
         if (map_ == nullptr) return;
@@ -1749,6 +1749,7 @@ EX hyperpoint direct_exp(hyperpoint v) {
 constexpr flagtype pfNO_INTERPOLATION = 1; /**< in tables (sol/nih geometries), do not use interpolations */
 constexpr flagtype pfNO_DISTANCE      = 2; /**< we just need the directions -- this makes it a bit faster in sol/nih geometries */
 constexpr flagtype pfLOW_BS_ITER      = 4; /**< low iterations in binary search (nil geometry, sl2 not affected currently) */
+constexpr flagtype pfFLOAT_TABLES     = 8; /**< in tables (sol/nih geometries), interpolate in single precision */
 
 constexpr flagtype pQUICK     = pfNO_INTERPOLATION | pfLOW_BS_ITER;
 
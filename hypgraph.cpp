@@ -3294,7 +3294,99 @@ EX shiftmatrix optimized_shift(const shiftmatrix& T) {
   }
 
 EX namespace dq {
-  EX queue<pair<heptagon*, shiftmatrix>> drawqueue;
+
+  #if HDR
+  /** \brief a set of pointers or hashes, cleared in O(1) by bumping the generation
+   *
+   *  Open addressing with linear probing; the table only grows, so that the
+   *  per-frame traversals do not allocate once the working set is known.
+   */
+  template<class T> struct visited_table {
+    vector<T> keys;
+    vector<unsigned> stamp;
+    unsigned generation = 1;
+    int used = 0, bits = 0;
+
+    int slot(T x) const { return int((((uint64_t) x) * 0x9E3779B97F4A7C15ull) >> (64 - bits)); }
+
+    bool count(T x) const {
+      if(!used) return false;
+      int mask = isize(keys) - 1;
+      for(int i = slot(x);; i = (i+1) & mask) {
+        if(stamp[i] != generation) return false;
+        if(keys[i] == x) return true;
+        }
+      }
+
+    /** returns false if x was already in the table */
+    bool insert(T x) {
+      if(2 * (used+1) > isize(keys)) grow();
+      int mask = isize(keys) - 1;
+      for(int i = slot(x);; i = (i+1) & mask) {
+        if(stamp[i] != generation) { stamp[i] = generation; keys[i] = x; used++; return true; }
+        if(keys[i] == x) return false;
+        }
+      }
+
+    void grow() {
+      vector<T> old;
+      for(int i=0; i<isize(keys); i++) if(stamp[i] == generation) old.push_back(keys[i]);
+      bits = bits ? bits + 1 : 10;
+      keys.resize(1 << bits); stamp.assign(1 << bits, 0);
+      generation = 1; used = 0;
+      for(auto x: old) insert(x);
+      }
+
+    void clear() {
+      used = 0;
+      if(!++generation) { for(auto& s: stamp) s = 0; generation = 1; }
+      }
+
+    int size() const { return used; }
+    };
+
+  /** \brief a FIFO queue which keeps its memory between frames
+   *
+   *  The elements are stored in fixed-size chunks which are never moved, so, as with std::queue,
+   *  a reference to front() stays valid while elements are pushed, until it is popped.
+   *  Chunks emptied at the front are reused at the back.
+   */
+  template<class T> struct ring_queue {
+    static constexpr int chunk_bits = 8, chunk_size = 1 << chunk_bits;
+    /** chunks[0] holds the front; moving a vector<T> keeps its buffer, so elements do not move when chunks does */
+    vector<vector<T>> chunks, spare;
+    /** positions in the concatenation of chunks; head < chunk_size */
+    int head = 0, tail = 0;
+
+    bool empty() const { return head == tail; }
+    int size() const { return tail - head; }
+    T& front() { return chunks[0][head]; }
+
+    void pop() {
+      head++;
+      if(head == tail) { clear(); return; }
+      if(head == chunk_size) {
+        spare.push_back(std::move(chunks[0]));
+        chunks.erase(chunks.begin());
+        head -= chunk_size; tail -= chunk_size;
+        }
+      }
+
+    template<class... U> void emplace(U&&... u) {
+      if(tail == isize(chunks) * chunk_size) {
+        if(spare.empty()) chunks.push_back(vector<T>(chunk_size));
+        else { chunks.push_back(std::move(spare.back())); spare.pop_back(); }
+        }
+      chunks[tail >> chunk_bits][tail & (chunk_size-1)] = T(std::forward<U>(u)...);
+      tail++;
+      }
+    void push(const T& x) { emplace(x); }
+
+    void clear() { head = tail = 0; }
+    };
+  #endif
+
+  EX ring_queue<pair<heptagon*, shiftmatrix>> drawqueue;
   
   EX buckethash_t bucketer(const shiftpoint& T) {
     if(cgi.emb->is_euc_in_sl2()) {
@@ -3304,36 +3396,32 @@ EX namespace dq {
     return hashmix_to(bucketer(T.h), hr::bucketer(T.shift));
     }
 
-  EX set<heptagon*> visited;
+  EX visited_table<heptagon*> visited;
   EX void enqueue(heptagon *h, const shiftmatrix& T) {
-    if(!h || visited.count(h)) { return; }
-    visited.insert(h);
+    if(!h || !visited.insert(h)) { return; }
     drawqueue.emplace(h, T);
     }  
 
-  EX set<buckethash_t> visited_by_matrix;
+  EX visited_table<buckethash_t> visited_by_matrix;
   EX void enqueue_by_matrix(heptagon *h, const shiftmatrix& T) {
     if(!h) return;
     buckethash_t b = bucketer(T * tile_center());
-    if(visited_by_matrix.count(b)) { return; }
-    visited_by_matrix.insert(b);
+    if(!visited_by_matrix.insert(b)) { return; }
     drawqueue.emplace(h, T);
     }
 
-  EX queue<pair<cell*, shiftmatrix>> drawqueue_c;
-  EX set<cell*> visited_c;
+  EX ring_queue<pair<cell*, shiftmatrix>> drawqueue_c;
+  EX visited_table<cell*> visited_c;
 
   EX void enqueue_c(cell *c, const shiftmatrix& T) {
-    if(!c || visited_c.count(c)) { return; }
-    visited_c.insert(c);
+    if(!c || !visited_c.insert(c)) { return; }
     drawqueue_c.emplace(c, T);
     }
 
   EX void enqueue_by_matrix_c(cell *c, const shiftmatrix& T) {
     if(!c) return;
     buckethash_t b = bucketer(T * tile_center());
-    if(visited_by_matrix.count(b)) { return; }
-    visited_by_matrix.insert(b);
+    if(!visited_by_matrix.insert(b)) { return; }
     drawqueue_c.emplace(c, T);
     }
   
@@ -3341,8 +3429,8 @@ EX namespace dq {
     visited.clear();
     visited_by_matrix.clear();
     visited_c.clear();
-    while(!drawqueue_c.empty()) drawqueue_c.pop();
-    while(!drawqueue.empty()) drawqueue.pop();
+    drawqueue_c.clear();
+    drawqueue.clear();
     }
 
 
@@ -95,15 +95,10 @@ struct gcell {
   /** \brief wall parameter, used e.g. for remaining power of Bonfires and Thumpers */
   char wparam;
   
-  #ifdef CELLID
+  /** \brief dense index of this cell in cell_ids */
   int cellid;
-  #endif
   
-  gcell() {
-    #ifdef CELLID
-    cellid = cellcount;  
-    #endif
-    }
+  gcell() : cellid(0) {}
   };
 
 #define landparam LHU.landpar
@@ -178,11 +173,57 @@ template<class T> struct connection_table {
  * RAM, so we really need to be careful on low memory devices. 
  */
 
+/** \brief Slab allocator used by hr::tailored_alloc.
+ *
+ *  Objects are size-classed by their byte size (so by class and degree), and carved out of 
+ *  large chunks, so that cells and heptagons created together are also close in memory.
+ *  Freed objects go to a per-class free list. Every chunk (slab) belongs to one size class and
+ *  counts its live objects; release_empty(), called by save_memory(), returns the slabs without
+ *  live objects to the system. All the chunks are returned at once by release_all(), which
+ *  clearCellMemory() calls when no objects are left.
+ */
+struct slab_arena {
+  static constexpr int chunk_size = 1<<16;
+  struct slab {
+    char *start;
+    int size, cls, live;
+    };
+  /** \brief a freed object, on the free list of its size class */
+  struct free_node {
+    free_node *next;
+    int slab;
+    };
+  struct sizeclass {
+    char *next = nullptr, *end = nullptr;
+    /** \brief the slab next and end point into, or -1 */
+    int current = -1;
+    free_node *free_list = nullptr;
+    };
+  vector<sizeclass> classes;
+  /** \brief released slabs have start == nullptr, and their ids are reused */
+  vector<slab> slabs;
+  vector<int> free_slab_ids;
+  /** \brief slab ids by the start of the slab, to find the slab of a freed object */
+  std::map<char*, int> slab_at;
+  /** \brief the number of objects currently allocated */
+  int live = 0;
+  void *alloc(int bytes);
+  void free(void *p, int bytes);
+  void release_all();
+  /** \brief return the slabs without live objects to the system; returns the number of bytes released */
+  size_t release_empty();
+  };
+
+extern slab_arena tailored_arena;
+
+template<class T> int tailored_size(int degree) {
+  return offsetof(T, c) + offsetof(connection_table<T>, move_table) + sizeof(T*) * degree + degree;
+  }
+
 template<class T> T* tailored_alloc(int degree) {
   T* result;
 #ifndef NO_TAILORED_ALLOC
-  int b = offsetof(T, c) + offsetof(connection_table<T>, move_table) + sizeof(T*) * degree + degree;
-  result = (T*) new char[b];
+  result = (T*) tailored_arena.alloc(tailored_size<T>(degree));
   new (result) T();
 #else
   result = new T;
@@ -194,8 +235,13 @@ template<class T> T* tailored_alloc(int degree) {
 
 /** \brief Counterpart to hr::tailored_alloc(). */
 template<class T> void tailored_delete(T* x) {
+#ifndef NO_TAILORED_ALLOC
+  int b = tailored_size<T>(x->degree());
   x->~T();  
-  delete[] ((char*) (x));
+  tailored_arena.free(x, b);
+#else
+  delete x;
+#endif
   }
 
 static constexpr struct wstep_t {} wstep = {};
@@ -474,6 +520,92 @@ inline cellwalker operator+ (heptspin hs, cth_t) { return cellwalker(hs.at->c7,
 
 #endif
 
+slab_arena tailored_arena;
+
+/** every object has to be large enough to hold a free_node once it is freed */
+static int slab_bytes(int bytes) {
+  return max<int>((bytes + 7) & ~7, (sizeof(slab_arena::free_node) + 7) & ~7);
+  }
+
+void *slab_arena::alloc(int bytes) {
+  bytes = slab_bytes(bytes);
+  int id = bytes >> 3;
+  if(id >= isize(classes)) classes.resize(id+1);
+  auto& sc = classes[id];
+  live++;
+  if(sc.free_list) {
+    free_node *res = sc.free_list;
+    sc.free_list = res->next;
+    slabs[res->slab].live++;
+    return res;
+    }
+  if(sc.current < 0 || sc.next + bytes > sc.end) {
+    int size = bytes > chunk_size ? bytes : chunk_size;
+    char *ch = new char[size];
+    int sid;
+    if(free_slab_ids.empty()) sid = isize(slabs), slabs.emplace_back();
+    else sid = free_slab_ids.back(), free_slab_ids.pop_back();
+    slabs[sid] = slab{ch, size, id, 0};
+    slab_at[ch] = sid;
+    sc.current = sid; sc.next = ch; sc.end = ch + size;
+    }
+  slabs[sc.current].live++;
+  void *res = sc.next;
+  sc.next += bytes;
+  return res;
+  }
+
+void slab_arena::free(void *p, int bytes) {
+  bytes = slab_bytes(bytes);
+  auto& sc = classes[bytes >> 3];
+  auto it = slab_at.upper_bound((char*) p);
+  it--;
+  free_node *n = (free_node*) p;
+  n->next = sc.free_list;
+  n->slab = it->second;
+  sc.free_list = n;
+  slabs[it->second].live--;
+  live--;
+  }
+
+void slab_arena::release_all() {
+  for(auto& s: slabs) if(s.start) delete[] s.start;
+  slabs.clear();
+  free_slab_ids.clear();
+  slab_at.clear();
+  classes.clear();
+  live = 0;
+  }
+
+size_t slab_arena::release_empty() {
+  vector<bool> empty(isize(slabs), false);
+  bool any = false;
+  for(int i=0; i<isize(slabs); i++) if(slabs[i].start && slabs[i].live == 0) empty[i] = any = true;
+  if(!any) return 0;
+
+  /* drop the free objects in the empty slabs from the free lists */
+  for(auto& sc: classes) {
+    free_node **at = &sc.free_list;
+    while(*at) {
+      if(empty[(*at)->slab]) *at = (*at)->next;
+      else at = &(*at)->next;
+      }
+    }
+
+  size_t res = 0;
+  for(int i=0; i<isize(slabs); i++) if(empty[i]) {
+    auto& s = slabs[i];
+    auto& sc = classes[s.cls];
+    if(sc.current == i) sc.current = -1, sc.next = sc.end = nullptr;
+    slab_at.erase(s.start);
+    delete[] s.start;
+    res += s.size;
+    s.start = nullptr;
+    free_slab_ids.push_back(i);
+    }
+  return res;
+  }
+
 EX bool proper(cell *c, int d) { return d >= 0 && d < c->type; }
 
 /** return b-a, as in, a number x such that a+x == b. */
@@ -1213,9 +1213,10 @@ EX void groupmove(eMonster movtype, flagtype mf) {
   
   targetcount = isize(gendfs);
   
+  vector<int> dirtable;
   for(int i=0; i<isize(gendfs); i++) {
     cell *c = gendfs[i];
-    vector<int> dirtable;
+    dirtable.clear();
     
     forCellIdAll(c2,t,c) dirtable.push_back(t);
     hrandom_shuffle(dirtable);
@@ -1356,9 +1357,10 @@ EX void movehex(bool mounted, int colorpair) {
     }
   //hexdfs.push_back(cwt.at);
   
+  vector<int> dirtable;
   for(int i=0; i<isize(hexdfs); i++) {
     cell *c = hexdfs[i];
-    vector<int> dirtable;
+    dirtable.clear();
     for(int t=0; t<c->type; t++) if(c->move(t) && inpair(c->move(t), colorpair))
       dirtable.push_back(t);
       
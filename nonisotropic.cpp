@@ -62,73 +62,309 @@ EX namespace sn {
   inline hyperpoint decompress(compressed_point p) { return point3(p[0], p[1], p[2]); }
   inline compressed_point compress(hyperpoint h) { return make_array<float>(h[0], h[1], h[2]); }
 
+  /** \brief header of the geodesic table files
+   *
+   *  Older files start with just PRECX, PRECY, PRECZ; these are still accepted.
+   */
+  struct geodesic_table_header {
+    char magic[4];
+    int version;
+    int PRECX, PRECY, PRECZ;
+    /** where the table starts, counted from the beginning of the file */
+    int data_offset;
+    };
+
+  static constexpr int geodesic_table_version = 1;
+
   struct tabled_inverses {
     int PRECX, PRECY, PRECZ;
+    /** the table if it has been read or computed in memory */
     vector<compressed_point> tab;
+    /** the table data: either tab, or the memory-mapped file */
+    compressed_point *data;
     string fname;
     bool loaded;
     
     void load();
-    hyperpoint get(ld ix, ld iy, ld iz, bool lazy);
+    bool load_from(const string& s);
+    void alloc(int X, int Y, int Z);
+    void save(const string& s);
+    void release();
+    /** \brief copy a memory-mapped table into tab, so that it can be changed */
+    void make_writable();
+    /** \brief the table value at (ix, iy, iz) in [0,1]^3; of flags, pfNO_INTERPOLATION and pfFLOAT_TABLES are used */
+    hyperpoint get(ld ix, ld iy, ld iz, flagtype flags);
+    /** \brief get for n points, given as (ix, iy, iz) in in[i] */
+    void get_batch(int n, const hyperpoint *in, hyperpoint *out, flagtype flags);
+
+    /** \brief split a table coordinate, already multiplied by prec-1, into a cell in [0, prec-2] and the position in that cell
+     *
+     *  The cell is computed in ld: converting the coordinate to float first could round it up into the last row,
+     *  and the interpolation would then read past the end of the table. Values past the end and NaN go to the last cell.
+     */
+    static int split_coordinate(ld i, int prec, ld& frac) {
+      if(!(i < prec-1)) i = prec-2;
+      int a = i > 0 ? int(i) : 0;
+      frac = i - a;
+      return a;
+      }
+
+    /** \brief the nearest table index to a coordinate, already multiplied by prec-1, clamped to the table */
+    static int round_coordinate(ld i, int prec) {
+      if(!(i < prec-1)) return prec-1;
+      return i > 0 ? int(i+.5) : 0;
+      }
+
+    /** \brief trilinear interpolation in the cell (ax, ay, az), obtained from split_coordinate; T is ld or float */
+    template<class T> void interpolate(int ax, int ay, int az, T fx, T fy, T fz, T *res) {
+      const compressed_point *p = &get_int(ax, ay, az);
+      int dy = PRECX, dz = PRECX * PRECY;
+      for(int t=0; t<3; t++) {
+        T c00 = p[0][t] * (1-fz) + p[dz][t] * fz;
+        T c10 = p[1][t] * (1-fz) + p[dz+1][t] * fz;
+        T c01 = p[dy][t] * (1-fz) + p[dy+dz][t] * fz;
+        T c11 = p[dy+1][t] * (1-fz) + p[dy+dz+1][t] * fz;
+        T c0 = c00 * (1-fy) + c01 * fy;
+        T c1 = c10 * (1-fy) + c11 * fy;
+        res[t] = c0 * (1-fx) + c1 * fx;
+        }
+      }
     
-    compressed_point& get_int(int ix, int iy, int iz) { return tab[(iz*PRECY+iy)*PRECX+ix]; }
+    compressed_point& get_int(int ix, int iy, int iz) { return data[(iz*PRECY+iy)*PRECX+ix]; }
   
     GLuint texture_id;
     bool toload;
+
+    #if CAP_MMAP
+    void *mapped;
+    size_t mapped_size;
+    #endif
     
     GLuint get_texture_id();
   
-    tabled_inverses(string s) : fname(s), texture_id(0), toload(true) {}  
+    tabled_inverses(string s) : data(nullptr), fname(s), loaded(false), texture_id(0), toload(true) {
+      #if CAP_MMAP
+      mapped = nullptr; mapped_size = 0;
+      #endif
+      }
     };
   #endif
+
+  /** \brief if non-zero, try to use the tables of this resolution first (e.g. solv-geodesics-128.dat) */
+  EX int geodesic_table_resolution = 0;
+
+  void tabled_inverses::release() {
+    #if CAP_MMAP
+    if(mapped) munmap(mapped, mapped_size);
+    mapped = nullptr;
+    #endif
+    tab.clear();
+    data = nullptr;
+    loaded = false;
+    toload = true;
+    }
+
+  void tabled_inverses::make_writable() {
+    #if CAP_MMAP
+    if(!mapped) return;
+    tab.assign(data, data + PRECX * PRECY * PRECZ);
+    munmap(mapped, mapped_size);
+    mapped = nullptr;
+    data = &tab[0];
+    #endif
+    }
+
+  void tabled_inverses::alloc(int X, int Y, int Z) {
+    release();
+    PRECX = X; PRECY = Y; PRECZ = Z;
+    tab.resize(X * Y * Z);
+    data = &tab[0];
+    loaded = true;
+    }
+
+  bool tabled_inverses::load_from(const string& s) {
+    FILE *f = fopen(find_file(s).c_str(), "rb");
+    if(!f) return false;
+
+    fseek(f, 0, SEEK_END);
+    size_t fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    geodesic_table_header h;
+    size_t offset;
+    if(fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, "HRGT", 4) == 0) {
+      if(h.version != geodesic_table_version) {
+        println(hlog, s, ": unknown geodesic table version ", h.version);
+        fclose(f); return false;
+        }
+      if(h.data_offset < int(sizeof(h))) {
+        println(hlog, s, ": geodesic table is damaged");
+        fclose(f); return false;
+        }
+      PRECX = h.PRECX; PRECY = h.PRECY; PRECZ = h.PRECZ;
+      offset = h.data_offset;
+      }
+    else {
+      fseek(f, 0, SEEK_SET);
+      hr::ignore(fread(&PRECX, 4, 1, f));
+      hr::ignore(fread(&PRECY, 4, 1, f));
+      hr::ignore(fread(&PRECZ, 4, 1, f));
+      offset = 12;
+      }
+
+    size_t bytes = sizeof(compressed_point) * PRECX * PRECY * PRECZ;
+    if(PRECX < 2 || PRECY < 2 || PRECZ < 2 || bytes > fsize || offset > fsize - bytes) {
+      println(hlog, s, ": geodesic table is damaged");
+      fclose(f); return false;
+      }
+
+    #if CAP_MMAP
+    /* map the file read-only: the pages are shared with other processes using the same table, and only read when needed */
+    void *m = mmap(nullptr, offset + bytes, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if(m != MAP_FAILED) {
+      fclose(f);
+      mapped = m; mapped_size = offset + bytes;
+      data = (compressed_point*) ((char*) m + offset);
+      return true;
+      }
+    #endif
+
+    tab.resize(PRECX * PRECY * PRECZ);
+    fseek(f, offset, SEEK_SET);
+    hr::ignore(fread(&tab[0], bytes, 1, f));
+    fclose(f);
+    data = &tab[0];
+    return true;
+    }
+
+  void tabled_inverses::save(const string& s) {
+    FILE *f = fopen(s.c_str(), "wb");
+    if(!f) { println(hlog, "cannot write ", s); return; }
+    geodesic_table_header h;
+    memcpy(h.magic, "HRGT", 4);
+    h.version = geodesic_table_version;
+    h.PRECX = PRECX; h.PRECY = PRECY; h.PRECZ = PRECZ;
+    h.data_offset = 64;
+    fwrite(&h, sizeof(h), 1, f);
+    for(int i=sizeof(h); i<h.data_offset; i++) fputc(0, f);
+    fwrite(data, sizeof(compressed_point) * PRECX * PRECY * PRECZ, 1, f);
+    fclose(f);
+    }
   
   void tabled_inverses::load() {
     if(loaded) return;
-    FILE *f = fopen(find_file(fname).c_str(), "rb");
-    if(!f) { addMessage(XLAT("geodesic table missing")); pmodel = mdPerspective; return; }
-    hr::ignore(fread(&PRECX, 4, 1, f));
-    hr::ignore(fread(&PRECY, 4, 1, f));
-    hr::ignore(fread(&PRECZ, 4, 1, f));
-    tab.resize(PRECX * PRECY * PRECZ);
-    hr::ignore(fread(&tab[0], sizeof(compressed_point) * PRECX * PRECY * PRECZ, 1, f));
-    fclose(f);
+    string s = fname;
+    if(geodesic_table_resolution) {
+      string s1 = s.substr(0, s.size() - 4) + "-" + its(geodesic_table_resolution) + ".dat";
+      if(load_from(s1)) { loaded = true; return; }
+      }
+    if(!load_from(s)) { addMessage(XLAT("geodesic table missing")); pmodel = mdPerspective; return; }
     loaded = true;    
     }
   
-  hyperpoint tabled_inverses::get(ld ix, ld iy, ld iz, bool lazy) {
+  hyperpoint tabled_inverses::get(ld ix, ld iy, ld iz, flagtype flags) {
     ix *= PRECX-1;
     iy *= PRECY-1;
     iz *= PRECZ-1;
     
-    hyperpoint res;
-    
-    if(lazy) {
+    if(flags & pfNO_INTERPOLATION) {
       if(isnan(ix) || isnan(iy) || isnan(iz)) return Hypc;
-      return decompress(get_int(int(ix+.5), int(iy+.5), int(iz+.5)));
+      return decompress(get_int(round_coordinate(ix, PRECX), round_coordinate(iy, PRECY), round_coordinate(iz, PRECZ)));
       }
-    
-    else {
-  
-      if(ix >= PRECX-1 || isnan(ix)) ix = PRECX-2;
-      if(iy >= PRECX-1 || isnan(iy)) iy = PRECX-2;
-      if(iz >= PRECZ-1 || isnan(iz)) iz = PRECZ-2;
-      
-      int ax = ix, bx = ax+1;
-      int ay = iy, by = ay+1;
-      int az = iz, bz = az+1;
-      
-      #define S0(x,y,z) get_int(x, y, z)[t]
-      #define S1(x,y) (S0(x,y,az) * (bz-iz) + S0(x,y,bz) * (iz-az))
-      #define S2(x) (S1(x,ay) * (by-iy) + S1(x,by) * (iy-ay))
   
-      for(int t=0; t<3; t++)
-        res[t] = S2(ax) * (bx-ix) + S2(bx) * (ix-ax);
-      
-      res[3] = 0;
+    ld fx, fy, fz;
+    int ax = split_coordinate(ix, PRECX, fx);
+    int ay = split_coordinate(iy, PRECY, fy);
+    int az = split_coordinate(iz, PRECZ, fz);
+
+    hyperpoint res = Hypc;
+    if(flags & pfFLOAT_TABLES) {
+      float r[3];
+      interpolate<float>(ax, ay, az, fx, fy, fz, r);
+      for(int t=0; t<3; t++) res[t] = r[t];
       }
-    
+    else
+      interpolate<ld>(ax, ay, az, fx, fy, fz, &res[0]);
     return res;
     }
+
+  void tabled_inverses::get_batch(int n, const hyperpoint *in, hyperpoint *out, flagtype flags) {
+    if((flags & pfNO_INTERPOLATION) || !(flags & pfFLOAT_TABLES)) {
+      for(int i=0; i<n; i++) out[i] = get(in[i][0], in[i][1], in[i][2], flags);
+      return;
+      }
+
+    /* the same computation as interpolate<float>, but split into passes over chunks:
+     * clamp the coordinates and find the cells, gather the eight corners, and then
+     * blend them in flat float loops */
+    constexpr int chunk = 64;
+    int idx[chunk];
+    float fx[chunk], fy[chunk], fz[chunk];
+    float c[8][chunk], r[chunk];
+    const int dy = PRECX, dz = PRECX * PRECY;
+    const int corner[8] = {0, 1, dy, dy+1, dz, dz+1, dy+dz, dy+dz+1};
+
+    for(int i0=0; i0<n; i0+=chunk) {
+      int k = min(chunk, n-i0);
+      for(int i=0; i<k; i++) {
+        const hyperpoint& h = in[i0+i];
+        ld lx, ly, lz;
+        int ax = split_coordinate(h[0] * (PRECX-1), PRECX, lx);
+        int ay = split_coordinate(h[1] * (PRECY-1), PRECY, ly);
+        int az = split_coordinate(h[2] * (PRECZ-1), PRECZ, lz);
+        fx[i] = lx; fy[i] = ly; fz[i] = lz;
+        idx[i] = (az*PRECY+ay)*PRECX+ax;
+        }
+      for(int t=0; t<3; t++) {
+        for(int j=0; j<8; j++)
+          for(int i=0; i<k; i++) c[j][i] = data[idx[i] + corner[j]][t];
+        for(int i=0; i<k; i++) {
+          float c00 = c[0][i] * (1-fz[i]) + c[4][i] * fz[i];
+          float c10 = c[1][i] * (1-fz[i]) + c[5][i] * fz[i];
+          float c01 = c[2][i] * (1-fz[i]) + c[6][i] * fz[i];
+          float c11 = c[3][i] * (1-fz[i]) + c[7][i] * fz[i];
+          float c0 = c00 * (1-fy[i]) + c01 * fy[i];
+          float c1 = c10 * (1-fy[i]) + c11 * fy[i];
+          r[i] = c0 * (1-fx[i]) + c1 * fx[i];
+          }
+        for(int i=0; i<k; i++) out[i0+i][t] = r[i];
+        }
+      for(int i=0; i<k; i++) out[i0+i][3] = 0;
+      }
+    }
+
+  /** \brief test the table lookups of the current table on n random points and on the edges of the table
+   *
+   *  Prints the largest difference between get_batch and get, and between the float and ld interpolations.
+   */
+  EX void check_batch(int n) {
+    auto& s = get_tabled();
+    s.load();
+    if(!s.loaded) return;
+    vector<hyperpoint> in;
+    for(int i=0; i<n; i++) in.push_back(point3(randd(), randd(), randd()));
+    /* the edges: exactly at the end, just below it (which rounds to the end in float), past it, and NaN */
+    ld below = 1 - 1e-9, near_last = (s.PRECZ - 1 - 1e-7) / (s.PRECZ - 1);
+    for(ld a: {ld(0), below, ld(1)}) for(ld b: {ld(0), below, ld(1)}) for(ld c: {ld(0), near_last, below, ld(1), ld(1.5)})
+      in.push_back(point3(a, b, c));
+    in.push_back(point3(NAN, 1, NAN));
+    n = isize(in);
+    vector<hyperpoint> res(n);
+    ld batch_err = 0, float_err = 0;
+    for(flagtype f: {flagtype(0), pfFLOAT_TABLES, pfNO_INTERPOLATION, pfFLOAT_TABLES | pfNO_INTERPOLATION}) {
+      s.get_batch(n, &in[0], &res[0], f);
+      for(int i=0; i<n; i++) {
+        hyperpoint h = s.get(in[i][0], in[i][1], in[i][2], f);
+        for(int t=0; t<4; t++) batch_err = max<ld>(batch_err, abs(res[i][t] - h[t]));
+        }
+      }
+    for(auto& h: in) {
+      hyperpoint a = s.get(h[0], h[1], h[2], 0), b = s.get(h[0], h[1], h[2], pfFLOAT_TABLES);
+      for(int t=0; t<4; t++) float_err = max<ld>(float_err, abs(a[t] - b[t]) / max<ld>(1, abs(a[t])));
+      }
+    println(hlog, "get_batch vs get, largest difference: ", batch_err);
+    println(hlog, "float vs ld interpolation, largest relative difference: ", float_err);
+    }
   
   GLuint tabled_inverses::get_texture_id() {
     #if CAP_GL
@@ -154,7 +390,7 @@ EX namespace sn {
     auto xbuffer = new glvertex[PRECZ*PRECY*PRECX];
     
     for(int z=0; z<PRECZ*PRECY*PRECX; z++) {
-      auto& t = tab[z];
+      auto& t = data[z];
       xbuffer[z] = glhr::makevertex(t[0], t[1], t[2]);
       }
     
@@ -524,41 +760,54 @@ EX namespace sn {
       }
     }
   
-  EX hyperpoint get_inverse_exp_symsol(hyperpoint h, flagtype flags) {
-    auto& s = get_tabled();
-    s.load();
-    
+  /** the coordinates in the table for get_inverse_exp_symsol (sym) and get_inverse_exp_nsym */
+  hyperpoint table_coordinates(hyperpoint h, bool sym) {
     ld ix = h[0] >= 0. ? sn::x_to_ix(h[0]) : sn::x_to_ix(-h[0]);
     ld iy = h[1] >= 0. ? sn::x_to_ix(h[1]) : sn::x_to_ix(-h[1]);
     ld iz = sn::z_to_iz(h[2]);
 
-    if(h[2] < 0.) { iz = -iz; swap(ix, iy); }
-    
-    hyperpoint res = s.get(ix, iy, iz, flags & pfNO_INTERPOLATION);
-  
-    if(h[2] < 0.) { swap(res[0], res[1]); res[2] = -res[2]; }
+    if(sym && h[2] < 0.) { iz = -iz; swap(ix, iy); }
+    return point3(ix, iy, iz);
+    }
+
+  /** undo the symmetries used in table_coordinates */
+  hyperpoint table_result(hyperpoint h, hyperpoint res, bool sym, flagtype flags) {
+    if(sym && h[2] < 0.) { swap(res[0], res[1]); res[2] = -res[2]; }
     if(h[0] < 0.) res[0] = -res[0];
     if(h[1] < 0.) res[1] = -res[1];
     
     if(flags & pfNO_DISTANCE) return res;
     return table_to_azeq(res);
     }
+  
+  EX hyperpoint get_inverse_exp_symsol(hyperpoint h, flagtype flags) {
+    auto& s = get_tabled();
+    s.load();
+    hyperpoint c = table_coordinates(h, true);
+    return table_result(h, s.get(c[0], c[1], c[2], flags), true, flags);
+    }
 
   EX hyperpoint get_inverse_exp_nsym(hyperpoint h, flagtype flags) {
     auto& s = get_tabled();
     s.load();
-    
-    ld ix = h[0] >= 0. ? sn::x_to_ix(h[0]) : sn::x_to_ix(-h[0]);
-    ld iy = h[1] >= 0. ? sn::x_to_ix(h[1]) : sn::x_to_ix(-h[1]);
-    ld iz = sn::z_to_iz(h[2]);
-    
-    hyperpoint res = s.get(ix, iy, iz, flags & pfNO_INTERPOLATION);
-  
-    if(h[0] < 0.) res[0] = -res[0];
-    if(h[1] < 0.) res[1] = -res[1];
-    
-    if(flags & pfNO_DISTANCE) return res;
-    return table_to_azeq(res);
+    hyperpoint c = table_coordinates(h, false);
+    return table_result(h, s.get(c[0], c[1], c[2], flags), false, flags);
+    }
+
+  /** \brief inverse_exp for n points at once, in the current Sol/NIH geometry */
+  EX void get_inverse_exp_batch(int n, const hyperpoint *h, hyperpoint *res, flagtype flags) {
+    auto& s = get_tabled();
+    s.load();
+    bool sym = !nih;
+    static vector<hyperpoint> coords;
+    coords.resize(n);
+    for(int i=0; i<n; i++) coords[i] = table_coordinates(h[i], sym);
+    s.get_batch(n, &coords[0], res, flags);
+    for(int i=0; i<n; i++) {
+      /* as in inverse_exp, this is more precise */
+      if(sqhypot_d(3, h[i]) < 2e-9) res[i] = h[i] - C0;
+      else res[i] = table_result(h[i], res[i], sym, flags);
+      }
     }
 
   EX string shader_symsol = sn::common +
@@ -3274,7 +3523,14 @@ EX namespace nisot {
   auto config = addHook(hooks_args, 0, [] () {
     using namespace arg;
     #if CAP_SOLV
-    if(argis("-solrange")) {
+    if(argis("-geodesic-batch-check")) {
+      PHASEFROM(2);
+      shift(); int n = argi();
+      if(!sn::in()) println(hlog, "not in Sol/NIH geometry");
+      else sn::check_batch(n);
+      return 0;
+      }
+    else if(argis("-solrange")) {
       shift_arg_formula(sn::solrange_xy);
       shift_arg_formula(sn::solrange_z);
       return 0;
@@ -1176,9 +1176,41 @@ length_adjusted_shapes& geometry_information::get_lash(ld len) {
   return res;
   }
 
+/** if building the shapes takes longer than this (in ms), show what is being built; 0 to never show */
+EX int shapes_progress_delay = 500;
+
+int shapes_progress_start;
+
+/** called between the stages of prepare_shapes; the game screen cannot be drawn here, since the shapes are not ready yet;
+ *  nothing is shown if the shapes are built in the middle of a frame, or while rendering to a renderbuffer */
+EX void shapes_progress(const string& stage) {
+  DEBB(debug_poly, ("stage: ", stage));
+#if CAP_SDL
+  int tick = SDL_GetTicks();
+  if(stage == "") { shapes_progress_start = tick; return; }
+  if(!graphics_on || headless || inHighQual || in_drawscreen || !shapes_progress_delay) return;
+  if(s != s_screen) return;
+  #if CAP_GL
+  if(current_rbuffer > 0) return;
+  #endif
+  if(tick < shapes_progress_start + shapes_progress_delay) return;
+  #if CAP_GL
+  if(vid.usingGL) setGLProjection();
+  else
+  #endif
+    SDL_FillSurfaceRect(s, NULL, backcolor);
+  displaystr(vid.xres/2, vid.yres/2, 0, vid.fsize, XLAT("building shapes: %1", stage), forecolor, 8);
+  #if CAP_GL
+  glflush();
+  #endif
+  present_screen();
+#endif
+  }
+
 void geometry_information::prepare_shapes() {
   require_basics();
   if(cgflags & qRAYONLY) return;
+  shapes_progress("");
   #if MAXMDIM >= 4 && CAP_GL
   if(GDIM == 3 && !floor_textures) make_floor_textures();
   #endif
@@ -1216,15 +1248,19 @@ void geometry_information::prepare_shapes() {
 
   make_sidewalls();
 
+  shapes_progress("procedural");
   procedural_shapes();
 
   #if MAXMDIM >= 4
+  shapes_progress("walls");
   create_wall3d();
   #endif
 
+  shapes_progress("floors");
   configure_floorshapes();
 
   // hand-drawn shapes
+  shapes_progress("hand-drawn");
 
   bshape(shHalfFloor[0], PPR::FLOOR, scalefactor, 329);
   bshape(shHalfFloor[1], PPR::FLOOR, scalefactor, 327);
@@ -1714,12 +1750,14 @@ void geometry_information::prepare_shapes() {
   bshape(shArrow, PPR::ARROW, 1, 252);
 
   #if MAXMDIM >= 4
+  shapes_progress("3D models");
   make_3d_models();
   #endif
 
   finishshape();
   prehpc = isize(hpc);
 
+  shapes_progress("buffers");
   initPolyForGL();
   }
 
@@ -2703,7 +2703,7 @@ EX int celldistance(cell *c1, cell *c2) {
   if(cgi.close_distances.count(b)) return cgi.close_distances[b];
   
   if(in_hrmap_rule_or_subrule())
-    return clueless_celldistance(c1, c2);
+    return clueless_celldistance(c1, c2, want_exact_distances);
 
   dynamicval<eGeometry> g(geometry, gBinary3);  
   #if CAP_BT
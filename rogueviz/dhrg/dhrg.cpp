@@ -113,6 +113,9 @@ int dhrgArgs() {
     ts_vertices = next_timestamp;
     }
     
+  else if(argis("-dhrg-threads")) {
+    shift(); threads = max(argi(), 1);
+    }
   else if(argis("-graph")) {
     PHASE(3); shift(); dhrg_init(); read_graph(args(), false, false, false);
     next_timestamp++;
@@ -1,11 +1,13 @@
 // log-likelihood computation
 
 #include <thread>
+#include <atomic>
 #define USE_THREADS
 
 namespace dhrg {
 
-int threads = 32;
+/** the number of threads used by DHRG computations; by default, what the machine offers */
+int threads = max<int>(1, std::thread::hardware_concurrency());
 
 ld llcont_approx_prec = 10000;
 
@@ -288,22 +290,24 @@ void writestats() {
   println(hlog, "Compression ratio = %", (placement_loglik+loglik_opt)/loglik_chaos);
   }
 
-template<class T> auto parallelize(long long N, T action) -> decltype(action(0,0)) {
+/** call action(a, b, k) for chunks [a, b) of [0, N), where k is the index of the thread; every thread takes the
+ *  next chunk as soon as it is done with the previous one, so ranges of very uneven cost are still balanced */
+template<class T> void parallel_chunks(long long N, long long chunk, const T& action) {
 #ifndef USE_THREADS
-  return action(0,N);
+  for(long long a=0; a<N; a+=chunk) action(a, min(N, a+chunk), 0);
 #else
-  if(threads == 1) return action(0,N);
+  std::atomic<long long> next(0);
+  auto work = [&] (int k) {
+    while(true) {
+      long long a = next.fetch_add(chunk);
+      if(a >= N) return;
+      action(a, min(N, a+chunk), k);
+      }
+    };
+  if(threads == 1) return work(0);
   std::vector<std::thread> v;
-  typedef decltype(action(0,0)) Res;
-  std::vector<Res> results(threads);
-  for(int k=0; k<threads; k++)
-    v.emplace_back([&,k] () { 
-      results[k] = action(N*k/threads, N*(k+1)/threads); 
-      });
+  for(int k=0; k<threads; k++) v.emplace_back(work, k);
   for(std::thread& t:v) t.join();
-  Res res = 0;
-  for(Res r: results) res += r;
-  return res;
 #endif
   }
 
@@ -332,31 +336,33 @@ void build_disttable_approx() {
 
   using namespace rogueviz;
 
+  /* row i costs i, so the rows are handed out dynamically, most expensive first */
   std::vector<vector<array<ll, 2>>> results(threads);
-  std::vector<std::thread> v;
-  for(int k=0; k<threads; k++)
-    v.emplace_back([&,k] () {
-      auto& dt = results[k];
-      vector<int> tab(N, N);
-      auto p = k ? nullptr : new progressbar(N/threads, "build_disttable_approx");
-      for(int i=k; i<N; i+=threads) {
-        if(p) (*p)++;
-        for(auto p: vdata[i].edges) {
-          int j = p.second->i ^ p.second->j ^ i;
-          if(j<i) tab[j] = i;
-          }
-        for(int j=0; j<i; j++) {
-          ld dist = precise_hdist(vertexcoords[i], vertexcoords[j]);
-          if(dist < 0) continue;
-          int dista = dist * llcont_approx_prec;
-          if(isize(dt) < dista+1)
-            dt.resize(dista+1, zero);
-          dt[dista][(tab[j] == i) ? 1 : 0]++;
-          }
+  std::vector<vector<int>> tabs(threads);
+  std::mutex pb_lock;
+  progressbar pb(N, "build_disttable_approx");
+
+  parallel_chunks(N, 16, [&] (int a, int b, int k) {
+    auto& dt = results[k];
+    auto& tab = tabs[k];
+    if(tab.empty()) tab.resize(N, N);
+    for(int i=N-1-a; i>N-1-b; i--) {
+      for(auto p: vdata[i].edges) {
+        int j = p.second->i ^ p.second->j ^ i;
+        if(j<i) tab[j] = i;
         }
-      if(p) delete p;
-      });
-  for(std::thread& t:v) t.join();
+      for(int j=0; j<i; j++) {
+        ld dist = precise_hdist(vertexcoords[i], vertexcoords[j]);
+        if(dist < 0) continue;
+        int dista = dist * llcont_approx_prec;
+        if(isize(dt) < dista+1)
+          dt.resize(dista+1, zero);
+        dt[dista][(tab[j] == i) ? 1 : 0]++;
+        }
+      }
+    std::lock_guard<std::mutex> g(pb_lock);
+    for(int i=a; i<b; i++) pb++;
+    });
   
   int mx = 0;
   for(auto& r: results) mx = max(mx, isize(r));
@@ -1128,7 +1128,7 @@ struct hrmap_notknot : hrmap {
   ~hrmap_notknot() {
     for(auto uc: all) {
       if(uc && uc->result) {
-        tailored_delete(uc->result->c7);
+        destroy_cell(uc->result->c7);
         tailored_delete(uc->result);
         }
       if(uc) delete uc;        
@@ -20,15 +20,17 @@ long long numiter = 0;
 int vizsa_start;
 int vizsa_len = 5;
   
-bool chance(double p) {
-  p *= double(hrngen.max()) + 1;
-  auto l = hrngen();
+template<class R> bool chance(double p, R& rng) {
+  p *= double(rng.max()) + 1;
+  auto l = rng();
   auto pv = (decltype(l)) p;
   if(l < pv) return true;
-  if(l == pv) return chance(p-pv);
+  if(l == pv) return chance(p-pv, rng);
   return false;
   }
 
+bool chance(double p) { return chance(p, hrngen); }
+
 bool twoway = false;
 int moves, nomoves;
 
@@ -77,6 +79,133 @@ void saiter() {
   cost += change;
   }
 
+/** parallel SA: every round, sa_threads threads propose sa_batch swaps each against the frozen state;
+ *  the accepted proposals are then merged serially, in a fixed order, dropping those which conflict
+ *  with swaps already applied in this round and re-evaluating those whose cost may have changed */
+int sa_threads = 1;
+int sa_batch = 256;
+
+/** the generator of thread k in round r is seeded from (sa_seed, r, k), so the results do not depend on scheduling */
+unsigned sa_seed = 0;
+
+long long sa_round;
+
+/** statistics: proposals dropped and re-evaluated during the merge */
+long long sa_conflicts, sa_reevaluated;
+
+struct sa_proposal { int t1, sid1, t2, sid2; double change; };
+
+/** the change in cost caused by swapping t1 at sid1 with t2 at sid2, computed without modifying sagid/sagnode */
+double swap_change(const sa_proposal& p) {
+  auto id = [&] (int j) { return (j == p.t1 || j == p.t2) ? -1 : sagid[j]; };
+  auto node = [&] (int s) { return (s == p.sid1 || s == p.sid2) ? -1 : sagnode[s]; };
+  return
+    costat_with(p.t1, p.sid2, id, node) + costat_with(p.t2, p.sid1, id, node)
+    - costat_with(p.t1, p.sid1, id, node) - costat_with(p.t2, p.sid2, id, node);
+  }
+
+vector<long long> node_moved, node_dirty, cell_moved, cell_dirty;
+
+/** one round of parallel SA; returns the number of iterations performed */
+int saround() {
+  int DN = isize(sagid);
+  int SN = isize(sagcells);
+  int K = max(sa_threads, 1);
+  sa_round++;
+
+  vector<vector<sa_proposal>> accepted(K);
+  vector<int> tried(K);
+
+  auto propose = [&] (int k) {
+    std::seed_seq seq{sa_seed, unsigned(sa_round), unsigned(sa_round >> 32), unsigned(k)};
+    std::mt19937 rng(seq);
+    auto& acc = accepted[k];
+    for(int i=0; i<sa_batch; i++) {
+      sa_proposal p;
+      p.t1 = rng() % DN;
+      p.sid1 = sagid[p.t1];
+      int s = twoway ? ((rng() & 1) ? 1 : 4) : rng() % 4 + 1;
+      if(s == 4) p.sid2 = rng() % SN;
+      else {
+        p.sid2 = p.sid1;
+        for(int ii=0; ii<s; ii++) {
+          auto& nei = neighbors[p.sid2];
+          p.sid2 = nei[rng() % isize(nei)];
+          }
+        }
+      p.t2 = allow_doubles ? -1 : sagnode[p.sid2];
+      if(fixed_position[p.t1] || (p.t2 >= 0 && fixed_position[p.t2])) continue;
+      tried[k]++;
+      p.change = swap_change(p);
+      if(p.change > 0 && (sagmode == sagHC || !chance(exp(-p.change * exp(-temperature)), rng))) continue;
+      acc.push_back(p);
+      }
+    };
+
+  #if CAP_THREAD
+  if(K > 1) {
+    std::vector<std::thread> v;
+    for(int k=0; k<K; k++) v.emplace_back(propose, k);
+    for(std::thread& t: v) t.join();
+    }
+  else
+  #endif
+  for(int k=0; k<K; k++) propose(k);
+
+  node_moved.resize(DN); node_dirty.resize(DN);
+  cell_moved.resize(SN); cell_dirty.resize(SN);
+
+  /* in smLogistic, edges_no makes the cost of every node depend on every other node */
+  bool all_dirty = false;
+  std::seed_seq merge_seq{sa_seed, unsigned(sa_round), unsigned(sa_round >> 32), unsigned(K)};
+  std::mt19937 merge_rng(merge_seq);
+
+  auto mark_node = [&] (int t) {
+    if(t < 0) return;
+    node_moved[t] = sa_round;
+    for(auto& e: edge_weights[t]) node_dirty[e.first] = sa_round;
+    };
+
+  auto mark_cell = [&] (int sid) {
+    cell_moved[sid] = sa_round;
+    for(int sid2: neighbors[sid]) cell_dirty[sid2] = sa_round;
+    };
+
+  int total = 0;
+  for(int k=0; k<K; k++) {
+    total += tried[k];
+    nomoves += tried[k] - isize(accepted[k]);
+    for(auto& p: accepted[k]) {
+      if(node_moved[p.t1] == sa_round || (p.t2 >= 0 && node_moved[p.t2] == sa_round) || cell_moved[p.sid1] == sa_round || cell_moved[p.sid2] == sa_round) {
+        sa_conflicts++; nomoves++; continue;
+        }
+      bool dirty = all_dirty || node_dirty[p.t1] == sa_round || (p.t2 >= 0 && node_dirty[p.t2] == sa_round) || cell_dirty[p.sid1] == sa_round || cell_dirty[p.sid2] == sa_round;
+      double change = p.change;
+      if(dirty) {
+        sa_reevaluated++;
+        change = swap_change(p);
+        if(change > 0 && (sagmode == sagHC || !chance(exp(-change * exp(-temperature)), merge_rng))) { nomoves++; continue; }
+        }
+      moves++;
+      sagnode[p.sid1] = p.t2; sagnode[p.sid2] = p.t1;
+      sagid[p.t1] = p.sid2; if(p.t2 >= 0) sagid[p.t2] = p.sid1;
+      mark_node(p.t1); mark_node(p.t2);
+      mark_cell(p.sid1); mark_cell(p.sid2);
+      if(method == smLogistic) all_dirty = true;
+      cost += change;
+      }
+    }
+
+  if(should_good) {
+    auto dcost = cost;
+    compute_cost();
+    if(abs(dcost - cost) > .1) throw hr_exception("dcost fail");
+    cost = dcost;
+    }
+
+  return total;
+  }
+
 ld checkmark_cost;
 
 int hillclimb() {
@@ -137,7 +266,13 @@ void dofullsa(ld satime) {
     if(d > 1) break;
 
     temperature = hightemp - (d*(hightemp-lowtemp));
-    for(int i=0; i<10000; i++) {
+    if(sa_threads > 1)
+      for(int i=0; i<10000;) {
+        int it = saround();
+        numiter += it; i += it;
+        if(!it) break;
+        }
+    else for(int i=0; i<10000; i++) {
       numiter++;
       sag::saiter();
       }
@@ -181,11 +316,18 @@ void dofullsa_iterations(long long saiter) {
 
   bool was_fixed = false;
 
-  for(int i=0; i<saiter; i++) {
+  for(long long i=0; i<saiter;) {
 
     temperature = hightemp - ((i+.5)/saiter*(hightemp-lowtemp));
-    numiter++;
-    sag::saiter();
+    if(sa_threads > 1) {
+      int it = saround();
+      if(!it) break;
+      numiter += it; i += it;
+      }
+    else {
+      numiter++; i++;
+      sag::saiter();
+      }
 
     if(recost_each && moves > recost_each) {
       last_ratio = moves / (moves + nomoves + 0.);
@@ -241,6 +383,15 @@ int anneal_read_args() {
       shift(); temperature = argf();
       }
     }
+  else if(argis("-sag-threads")) {
+    shift(); sa_threads = argi();
+    }
+  else if(argis("-sag-batch")) {
+    shift(); sa_batch = argi();
+    }
+  else if(argis("-sag-seed")) {
+    shift(); sa_seed = argi();
+    }
   else if(argis("-sag-recost")) {
     method = smLogistic; prepare_method();
     shift(); recost_each = argi();
@@ -56,7 +56,18 @@ int max_sag_dist;
 /** new style cell request */
 int cell_request;
 
-/** the structure type used to hold a N*N table of distances */
+/** tile size used when saving tiled distance tables */
+int sagdist_tile = 64;
+
+/** how many decoded tiles every thread keeps (each takes 2*tile*tile bytes, i.e., 8 KB for the default tile size) */
+int sagdist_cache_tiles = 256;
+
+/** the structure type used to hold a N*N table of distances
+ *
+ *  The table is either dense (tab), or tiled: split into tile*tile blocks, each stored as 8-bit offsets
+ *  from its minimum (or as raw values if the range is too large) and deflated if CAP_ZLIB. Tiles of a tiled
+ *  table are decoded on demand into a per-thread cache. Tiled tables are read-only.
+ */
 struct sagdist_t {
   using distance = unsigned short;
   distance* tab;
@@ -65,12 +76,101 @@ struct sagdist_t {
   size_t N;
   int format;
 
-  distance* begin() { return tab; }
-  distance* end() { return tab+N*N; }
+  /** for tiled tables */
+  int tile, tiles_per_row;
+  flagtype tile_flags;
+  vector<char> packed;
+  vector<size_t> tile_offset;
+  int generation;
 
-  sagdist_t() { tab = nullptr; fd = 0; format = 1; }
+  static constexpr flagtype tfDEFLATE = 1;
+  static constexpr int tiled_version = 1;
 
-  distance* operator [] (int y) { return tab + N * y; }
+  /** unique for every table contents loaded, in all the instances; the tile caches are keyed by it */
+  static int new_generation() {
+    static std::atomic<int> counter(0);
+    return ++counter;
+    }
+
+  /** a row for reading; tiled tables return copies from the tile cache */
+  struct row {
+    const sagdist_t *t;
+    const distance *r;
+    int y;
+    distance operator [] (int x) const { return r ? r[x] : t->tiled_at(y, x); }
+    };
+
+  /** call f on all the N*N values, in no particular order; tiled tables are decoded tile by tile, bypassing the cache */
+  template<class T> void for_all(const T& f) const {
+    if(tab) {
+      for(size_t i=0; i<N*N; i++) f(tab[i]);
+      return;
+      }
+    vector<distance> block(size_t(tile) * tile);
+    for(int ty=0; ty<tiles_per_row; ty++)
+    for(int tx=0; tx<tiles_per_row; tx++) {
+      decode_tile(ty * tiles_per_row + tx, &block[0]);
+      size_t rows = min<size_t>(tile, N - size_t(ty) * tile);
+      size_t cols = min<size_t>(tile, N - size_t(tx) * tile);
+      for(size_t y=0; y<rows; y++) for(size_t x=0; x<cols; x++) f(block[y * tile + x]);
+      }
+    }
+
+  sagdist_t() { tab = nullptr; fd = 0; format = 1; generation = new_generation(); }
+
+  row operator [] (int y) const { return row{this, tab ? tab + N * y : nullptr, y}; }
+
+  /** a row for writing; only dense tables can be changed */
+  distance* dense_row(int y) {
+    if(!tab) throw hr_exception("sagdist: tiled tables are read-only");
+    return tab + N * y;
+    }
+
+  void decode_tile(int tid, distance *out) const {
+    const char *p = &packed[tile_offset[tid]];
+    size_t len = tile_offset[tid+1] - tile_offset[tid];
+    size_t tsize = size_t(tile) * tile;
+    #if CAP_ZLIB
+    thread_local vector<char> inflated;
+    if(tile_flags & tfDEFLATE) {
+      inflated.resize(3 + tsize * sizeof(distance));
+      uLongf ilen = isize(inflated);
+      if(uncompress((Bytef*) &inflated[0], &ilen, (const Bytef*) p, len) != Z_OK) throw hr_exception("sagdist: bad tile");
+      p = &inflated[0]; len = ilen;
+      }
+    #else
+    if(tile_flags & tfDEFLATE) throw hr_exception("sagdist: tiled table is deflated but CAP_ZLIB is off");
+    #endif
+    if(len < 3 || len < 3 + tsize * (p[0] == 1 ? 1 : sizeof(distance))) throw hr_exception("sagdist: bad tile");
+    distance base;
+    memcpy(&base, p+1, sizeof(distance));
+    if(p[0] == 1) for(size_t i=0; i<tsize; i++) out[i] = base + (unsigned char) p[3+i];
+    else memcpy(out, p+3, tsize * sizeof(distance));
+    }
+
+  distance tiled_at(size_t y, size_t x) const {
+    struct tile_cache {
+      int generation = -1;
+      vector<int> key;
+      vector<distance> data;
+      };
+    thread_local tile_cache cache;
+    size_t tsize = size_t(tile) * tile;
+    if(cache.generation != generation) {
+      int slots = max(sagdist_cache_tiles, 1);
+      cache.generation = generation;
+      cache.key.assign(slots, -1);
+      cache.data.resize(slots * tsize);
+      }
+    int tid = (y / tile) * tiles_per_row + (x / tile);
+    int slot = tid % isize(cache.key);
+    distance *block = &cache.data[slot * tsize];
+    if(cache.key[slot] != tid) {
+      decode_tile(tid, block);
+      cache.key[slot] = tid;
+      }
+    return block[(y % tile) * tile + (x % tile)];
+    }
 
   void init(int _N, distance val) {
     clear();
@@ -139,8 +239,146 @@ struct sagdist_t {
     for(auto& row: old) for(auto val: row) *(ptr++) = val;
     }
 
+  void load_tiled(string fname) {
+    DEBBI(debug_init_sag, ("load_tiled ", fname));
+    clear();
+    FILE *f = fopen(fname.c_str(), "rb");
+    if(!f) throw hr_exception("open failed in load_tiled");
+    char magic[4];
+    int version;
+    long long tflags;
+    bool ok =
+      fread(magic, 4, 1, f) == 1 && memcmp(magic, "SAGT", 4) == 0 &&
+      fread(&version, sizeof(version), 1, f) == 1 && version == tiled_version &&
+      fread(&N, 8, 1, f) == 1 &&
+      fread(&tile, sizeof(tile), 1, f) == 1 &&
+      fread(&tflags, sizeof(tflags), 1, f) == 1;
+    if(ok) {
+      tile_flags = tflags;
+      tiles_per_row = (N + tile - 1) / tile;
+      size_t T = size_t(tiles_per_row) * tiles_per_row;
+      tile_offset.resize(T+1);
+      ok = tile > 0 && fread(&tile_offset[0], sizeof(size_t), T+1, f) == T+1 && tile_offset[0] == 0;
+      for(size_t i=0; ok && i<T; i++) if(tile_offset[i+1] < tile_offset[i]) ok = false;
+      if(ok) {
+        packed.resize(tile_offset[T]);
+        ok = packed.empty() || fread(&packed[0], 1, packed.size(), f) == packed.size();
+        }
+      }
+    fclose(f);
+    if(!ok) { clear(); throw hr_exception("file error in load_tiled"); }
+    generation = new_generation();
+    if(debug_init_sag) println(hlog, "tiled table: N = ", int(N), " tile = ", tile, " packed size = ", hr::format("%zd", packed.size()), "B, test: ", test());
+    }
+
+  static bool is_tiled(string fname) {
+    FILE *f = fopen(fname.c_str(), "rb");
+    if(!f) return false;
+    char magic[4];
+    bool res = fread(magic, 4, 1, f) == 1 && memcmp(magic, "SAGT", 4) == 0;
+    fclose(f);
+    return res;
+    }
+
+  /** save a tiled table; get_rows(y, k, buf) should put the rows y..y+k-1 into buf */
+  template<class T> static void save_tiled(string fname, size_t N, int tile, const T& get_rows) {
+    DEBBI(debug_init_sag, ("save_tiled ", fname));
+    int tpr = (N + tile - 1) / tile;
+    size_t tsize = size_t(tile) * tile;
+    vector<distance> band(N * tile);
+    vector<distance> block(tsize);
+    vector<char> record(3 + tsize * sizeof(distance));
+    vector<size_t> offsets = {0};
+    vector<char> data;
+    flagtype tflags = 0;
+    #if CAP_ZLIB
+    tflags |= tfDEFLATE;
+    vector<char> deflated(compressBound(record.size()));
+    #endif
+
+    for(int ty=0; ty<tpr; ty++) {
+      size_t y0 = size_t(ty) * tile;
+      size_t rows = min<size_t>(tile, N - y0);
+      get_rows(y0, rows, &band[0]);
+      for(int tx=0; tx<tpr; tx++) {
+        size_t x0 = size_t(tx) * tile;
+        distance lo = 65535, hi = 0;
+        for(int y=0; y<tile; y++) for(int x=0; x<tile; x++) {
+          distance d = (size_t(y) < rows && x0+x < N) ? band[y * N + x0 + x] : 0;
+          block[y * tile + x] = d;
+          lo = min(lo, d); hi = max(hi, d);
+          }
+        size_t rlen;
+        memcpy(&record[1], &lo, sizeof(distance));
+        if(hi - lo < 256) {
+          record[0] = 1;
+          for(size_t i=0; i<tsize; i++) record[3+i] = block[i] - lo;
+          rlen = 3 + tsize;
+          }
+        else {
+          record[0] = 2;
+          memcpy(&record[3], &block[0], tsize * sizeof(distance));
+          rlen = 3 + tsize * sizeof(distance);
+          }
+        const char *out = &record[0];
+        #if CAP_ZLIB
+        uLongf dlen = deflated.size();
+        if(compress2((Bytef*) &deflated[0], &dlen, (const Bytef*) &record[0], rlen, 6) != Z_OK) throw hr_exception("sagdist: compression failed");
+        out = &deflated[0]; rlen = dlen;
+        #endif
+        data.insert(data.end(), out, out + rlen);
+        offsets.push_back(data.size());
+        }
+      if(debug_progress && ty % 16 == 0) println(hlog, "tiled: band ", ty, "/", tpr, ", ", hr::format("%zd", data.size()), "B so far");
+      }
+
+    FILE *f = fopen(fname.c_str(), "wb");
+    if(!f) return file_error(fname);
+    long long tflags_ll = tflags;
+    bool ok =
+      fwrite("SAGT", 4, 1, f) == 1 &&
+      fwrite(&tiled_version, sizeof(tiled_version), 1, f) == 1 &&
+      fwrite(&N, 8, 1, f) == 1 &&
+      fwrite(&tile, sizeof(tile), 1, f) == 1 &&
+      fwrite(&tflags_ll, sizeof(tflags_ll), 1, f) == 1 &&
+      fwrite(&offsets[0], sizeof(size_t), offsets.size(), f) == offsets.size() &&
+      (data.empty() || fwrite(&data[0], 1, data.size(), f) == data.size());
+    fclose(f);
+    if(!ok) throw hr_exception("write error in save_tiled");
+    if(debug_init_sag) println(hlog, "tiled table saved: ", hr::format("%zd", data.size()), "B instead of ", hr::format("%zd", N * N * sizeof(distance)), "B");
+    }
+
+  void save_tiled(string fname) {
+    if(!tab) throw hr_exception("save_tiled: the table is not dense");
+    save_tiled(fname, N, sagdist_tile, [this] (size_t y, size_t k, distance *buf) {
+      memcpy(buf, tab + N * y, N * k * sizeof(distance));
+      });
+    }
+
+  /** convert a dense table file into the tiled format, reading only a band of rows at a time */
+  static void convert_to_tiled(string infile, string outfile) {
+    #ifdef O_BINARY
+    int ifd = open(infile.c_str(), O_RDONLY | O_BINARY);
+    #else
+    int ifd = open(infile.c_str(), O_RDONLY);
+    #endif
+    if(ifd == -1) throw hr_exception("open failed in convert_to_tiled");
+    size_t N;
+    if(read(ifd, &N, 8) < 8) throw hr_exception("file error");
+    save_tiled(outfile, N, sagdist_tile, [&] (size_t, size_t k, distance *buf) {
+      size_t size = N * k * sizeof(distance), offset = 0;
+      while(offset < size) {
+        ssize_t block = read(ifd, ((char*)buf)+offset, size-offset);
+        if(block <= 0) throw hr_exception("file error reading table");
+        offset += block;
+        }
+      });
+    ::close(ifd);
+    }
+
   void load(string fname) {
-    if(format == 1) {
+    if(is_tiled(fname)) load_tiled(fname);
+    else if(format == 1) {
       #ifdef LINUXX
       map(fname);
       #else
@@ -186,6 +424,9 @@ struct sagdist_t {
     #endif
     delete[] tab;
     tab = nullptr; fd = 0;
+    vector<char>().swap(packed);
+    vector<size_t>().swap(tile_offset);
+    generation = new_generation();
     }
 
   ~sagdist_t() {
@@ -293,7 +534,7 @@ void compute_dists() {
         pq.pop();
         for(auto e: dijkstra_edges[at]) visit(e.first, d + e.second);
         }
-      for(int j=0; j<N; j++) sagdist[i][j] = distances[j] * gdist_prec + .5;
+      for(int j=0; j<N; j++) sagdist.dense_row(i)[j] = distances[j] * gdist_prec + .5;
       }
     return 0;
     }
@@ -309,7 +550,7 @@ void compute_dists() {
     for(int i=0; i<N; i++)
     for(int j=0; j<N; j++) {
       ld d = pdist(cellpoint[i], cellpoint[j]);
-      sagdist[i][j] = (d + .5) * gdist_prec;
+      sagdist.dense_row(i)[j] = (d + .5) * gdist_prec;
       if(d > mx && debug_sag_cells)
         println(hlog, kz(cellpoint[i]), kz(cellpoint[j]), " :: ", mx = d);
       }
@@ -319,7 +560,7 @@ void compute_dists() {
     DEBBI(debug_init_sag, ("no gdist_prec"));
     sagdist.init(N, N);
     for(int i=0; i<N; i++) {
-      auto sdi = sagdist[i];
+      auto sdi = sagdist.dense_row(i);
       vector<int> q;
       auto visit = [&] (int j, int dist) { if(sdi[j] < N) return; sdi[j] = dist; q.push_back(j); };
       visit(i, 0);
@@ -328,7 +569,7 @@ void compute_dists() {
     }
   
   max_sag_dist = 0;
-  for(auto x: sagdist) max_sag_dist = max<int>(max_sag_dist, x);
+  sagdist.for_all([] (int x) { max_sag_dist = max(max_sag_dist, x); });
   max_sag_dist++;
   if(debug_init_sag)
     println(hlog, "max_sag_dist = ", max_sag_dist);
@@ -383,7 +624,7 @@ void compute_creq_neighbors() {
   for(int j=0; j<SN; j++) if(i != j && sagdist[i][j] < mindist_for[i] + mindist_for[j]) neighbors[i].push_back(j);
 
   max_sag_dist = 0;
-  for(auto x: sagdist) max_sag_dist = max<int>(max_sag_dist, x);
+  sagdist.for_all([] (int x) { max_sag_dist = max(max_sag_dist, x); });
   max_sag_dist++;
   if(debug_init_sag)
     println(hlog, "the neighors of 0 are ", neighbors[0]);
@@ -498,7 +739,7 @@ void init_cell_request() {
       for(int i=a; i<b; i++) {
         for(int j=0; j<SN; j++) {
           ld dist = pdist(sagsubcell_point[i], sagsubcell_point[j]);
-          sagdist[i][j] = int(dist * gdist_prec + 0.5);
+          sagdist.dense_row(i)[j] = int(dist * gdist_prec + 0.5);
           if(i < j && sagdist[i][j] == 0 && debug_sag_cells)
             println(hlog, "for ", tie(i,j), " pdist computed as ", dist);
           }
@@ -532,7 +773,7 @@ void init_cell_request() {
             visit(e.second, d + e.first);
             }
           }
-        for(int j=0; j<SN; j++) sagdist[i][j] = distances[j] * gdist_prec + .5;
+        for(int j=0; j<SN; j++) sagdist.dense_row(i)[j] = distances[j] * gdist_prec + .5;
         }
       return 0;
       });
@@ -602,7 +843,7 @@ void geo_stats() {
 
   println(hlog, "counting sagdist, N=", int(sagdist.N), " max_sag_dist = ", max_sag_dist);
   vector<short> sgdc(max_sag_dist, 0);
-  for(auto x: sagdist) sgdc[x]++;
+  sagdist.for_all([&] (int x) { sgdc[x]++; });
 
   println(hlog, "building sorted_sagdist");
   vector<short> sorted_sagdist;
@@ -670,6 +911,21 @@ int cell_read_args() {
     shift();
     sagdist.save(args());
     }
+  else if(argis("-sag_gdist_save_tiled")) {
+    init_cells();
+    shift();
+    sagdist.save_tiled(args());
+    }
+  else if(argis("-sag-gdist-tile")) {
+    shift(); sagdist_tile = argi();
+    }
+  else if(argis("-sag-gdist-cache")) {
+    shift(); sagdist_cache_tiles = argi();
+    }
+  else if(argis("-sag-gdist-convert")) {
+    shift(); string infile = args();
+    shift(); sagdist_t::convert_to_tiled(infile, args());
+    }
   else if(argis("-sag_gdist_load")) {
     distance_only = false;
     shift(); distance_file = args();
@@ -30,25 +30,26 @@ debugflag debug_opt("sag_opt");
 
 bool should_good = false;
 
-double costat(int vid, int sid) {
+/** the cost contributed by vid placed at sid, where id(j) gives the cell of node j and node(s) gives the node at cell s */
+template<class ID, class NODE> double costat_with(int vid, int sid, const ID& id, const NODE& node) {
   if(vid < 0) return 0;
   double cost = 0;
 
   switch(method) {
     case smLogistic: {
       auto s = sagdist[sid];
-      for(auto j: edges_yes[vid]) if(sagid[j] >= -1)
-        cost += loglik_tab_y[s[sagid[j]]];
-      for(auto j: edges_no[vid]) if(sagid[j] >= -1)
-        cost += loglik_tab_n[s[sagid[j]]];
+      for(auto j: edges_yes[vid]) if(id(j) >= 0)
+        cost += loglik_tab_y[s[id(j)]];
+      for(auto j: edges_no[vid]) if(id(j) >= 0)
+        cost += loglik_tab_n[s[id(j)]];
       return -cost;
       }
 
     case smMatch: {
       for(auto& e: edge_weights[vid]) {
         auto t2 = e.first;
-        if(sagid[t2] != -1) {
-          ld cdist = sagdist[sid][sagid[t2]];
+        if(id(t2) != -1) {
+          ld cdist = sagdist[sid][id(t2)];
           ld expect = match_a / e.second + match_b;
           ld dist = cdist - expect;
           cost += dist * dist;
@@ -60,12 +61,12 @@ double costat(int vid, int sid) {
     case smClosest: {
       for(auto& e: edge_weights[vid]) {
         auto t2 = e.first;
-        if(sagid[t2] != -1) cost += sagdist[sid][sagid[t2]] * e.second;
+        if(id(t2) != -1) cost += sagdist[sid][id(t2)] * e.second;
         }
       
       if(!hubval.empty()) {
         for(auto sid2: neighbors[sid]) {
-          int vid2 = sagnode[sid2];
+          int vid2 = node(sid2);
           if(vid2 >= 0 && (hubval[vid] & hubval[vid]) == 0)
             cost += hub_penalty;
           }
@@ -78,6 +79,10 @@ double costat(int vid, int sid) {
   throw hr_exception("unknwon SAG method");
   }
 
+double costat(int vid, int sid) {
+  return costat_with(vid, sid, [] (int j) { return sagid[j]; }, [] (int s) { return sagnode[s]; });
+  }
+
 double cost;
 
 double best_cost = 1000000000;
@@ -110,14 +110,114 @@ int qpct = 100;
 int t, lpct, cells;
 double maxdist;
 
-neuron& winner(int id) {
-  double bdiff = HUGE_VAL;
-  neuron *bcell = NULL;
-  for(neuron& n: net) {
-    double diff = vnorm(n.net, data[id].val);
-    if(diff < bdiff) bdiff = diff, bcell = &n;
+/** like vnorm, but gives up (every 32 columns) once the result is known to be at least bound;
+ *  the sum is taken in the same order as in vnorm, so the result is the same when it is below bound */
+double vnorm_bounded(const kohvec& a, const kohvec& b, double bound) {
+  double diff = 0;
+  for(int k=0; k<columns;) {
+    int k1 = min(k + 32, columns);
+    for(; k<k1; k++) diff += sqr((a[k]-b[k]) * weights[k]);
+    if(diff >= bound) return diff;
     }
-  return *bcell;
+  return diff;
+  }
+
+/** the exact best matching unit by brute force */
+int brute_winner(const kohvec& v) {
+  pair<double, int> best = {HUGE_VAL, -1};
+  for(int i=0; i<isize(net); i++) {
+    double diff = vnorm_bounded(net[i].net, v, best.first);
+    if(diff < best.first) best = {diff, i};
+    }
+  return best.second;
+  }
+
+/** steps between the rebuilds of bmu_index during training; 0 = do not use the index, always use brute force */
+int bmu_index_each = 0;
+
+/** a vantage-point tree over the neuron weights, for finding the best matching unit
+ *
+ *  The tree is built on the weights at the time of build(). step() reports how far every neuron has moved
+ *  since then, and the search loosens its pruning by that distance, so the results stay exact.
+ */
+struct bmu_index_t {
+  struct node { int id; double mu; int inside, outside; };
+  vector<node> nodes;
+  int root = -1;
+  int built_t = -1;
+  vector<double> drift;
+  double maxdrift = 0;
+
+  bool built() { return root >= 0 && isize(drift) == isize(net); }
+
+  void clear() { nodes.clear(); root = -1; drift.clear(); maxdrift = 0; }
+
+  double dist(int i, const kohvec& v) { return sqrt(vnorm_bounded(net[i].net, v, HUGE_VAL)); }
+
+  int build_range(vector<pair<double, int>>& ids, int from, int to, std::mt19937& rng) {
+    if(from >= to) return -1;
+    swap(ids[from], ids[from + rng() % (to - from)]);
+    int v = ids[from].second;
+    for(int i=from+1; i<to; i++) ids[i].first = dist(ids[i].second, net[v].net);
+    int mid = (from + 1 + to) / 2;
+    double mu = 0;
+    if(from + 1 < to) {
+      nth_element(ids.begin() + from + 1, ids.begin() + mid, ids.begin() + to);
+      mu = ids[mid].first;
+      }
+    int res = isize(nodes);
+    nodes.push_back(node{v, mu, -1, -1});
+    int in = build_range(ids, from+1, mid, rng);
+    int out = build_range(ids, mid, to, rng);
+    nodes[res].inside = in; nodes[res].outside = out;
+    return res;
+    }
+
+  void build() {
+    clear();
+    vector<pair<double, int>> ids;
+    for(int i=0; i<isize(net); i++) ids.emplace_back(0, i);
+    std::mt19937 rng(isize(net));
+    nodes.reserve(isize(net));
+    root = build_range(ids, 0, isize(ids), rng);
+    drift.resize(isize(net), 0);
+    built_t = t;
+    }
+
+  /** neuron i has moved by d since the last build; returns its total drift */
+  double moved(int i, double d) { return drift[i] += d; }
+
+  void search(int ni, const kohvec& v, pair<double, int>& best) {
+    if(ni < 0) return;
+    auto& nd = nodes[ni];
+    double dv = dist(nd.id, v);
+    if(make_pair(dv, nd.id) < best) best = {dv, nd.id};
+    /* lower bounds on the distance to the neurons in the subtrees, by the triangle inequality */
+    double slack = 2 * maxdrift;
+    auto lb_in = [&] { return dv - nd.mu - slack; };
+    auto lb_out = [&] { return nd.mu - dv - slack; };
+    if(dv < nd.mu) {
+      if(lb_in() <= best.first) search(nd.inside, v, best);
+      if(lb_out() <= best.first) search(nd.outside, v, best);
+      }
+    else {
+      if(lb_out() <= best.first) search(nd.outside, v, best);
+      if(lb_in() <= best.first) search(nd.inside, v, best);
+      }
+    }
+
+  int find(const kohvec& v) {
+    pair<double, int> best = {HUGE_VAL, -1};
+    search(root, v, best);
+    return best.second;
+    }
+  };
+
+bmu_index_t bmu_index;
+
+neuron& winner(int id) {
+  if(bmu_index_each && bmu_index.built()) return net[bmu_index.find(data[id].val)];
+  return net[brute_winner(data[id].val)];
   }
 
 void setindex(bool b) {
@@ -336,12 +436,17 @@ void distribute_neurons() {
   
   for(neuron& n: net) n.drawn_samples = 0, n.csample = 0;
   
-  for(auto p: sample_vdata_id) {
-    int s = p.first;
-    auto& w = winner(s);
-    whowon[s] = &w;
-    w.drawn_samples++;
-    }
+  if(bmu_index_each) bmu_index.build();
+  vector<int> ids;
+  for(auto p: sample_vdata_id) ids.push_back(p.first);
+  parallelize(isize(ids), [&] (int a, int b) {
+    for(int i=a; i<b; i++) {
+      auto& v = data[ids[i]].val;
+      whowon[ids[i]] = &net[bmu_index_each ? bmu_index.find(v) : brute_winner(v)];
+      }
+    return 0;
+    });
+  for(int s: ids) whowon[s]->drawn_samples++;
     
   map<cell*, neuron*> find;
   if(precise_placement >= 1)
@@ -463,6 +568,21 @@ struct cellcrawler {
       }
     }
 
+  /** like sprawl, but the targets are written to a separate vector, so that this can be used in parallel */
+  void sprawl_to(const cellwalker& start, vector<cellwalker>& targets) const {
+    targets.resize(isize(data));
+    targets[0] = start;
+    for(int i=1; i<isize(data); i++) {
+      auto& s = data[i];
+      auto& tg = targets[i];
+      tg = targets[s.from];
+      if(!tg.at) continue;
+      tg += s.spin;
+      if(!tg.peek()) tg.at = NULL;
+      else tg += wstep;
+      }
+    }
+
   vector<vector<float>> dispersion;
   };
 
@@ -644,9 +764,101 @@ int krad, kqty;
 
 double ttpower = 1;
 
+/** batch training: every step is an epoch which assigns every sample to its best matching unit, and then
+ *  replaces every neuron with the average of all samples, weighted by the neighborhood function of their winners;
+ *  the neighborhood function is the same as in step(), and an epoch uses up `samples` units of t */
+bool batch_som = false;
+
+void batch_step() {
+  if(t == 0) return;
+  initialize_dispersion();
+  initialize_neurons_initial();
+
+  double tt = (t-.5) / tmax;
+  tt = pow(tt, ttpower);
+  double sigma = maxdist * tt;
+
+  vector<int> bmu(samples);
+  if(bmu_index_each) bmu_index.build();
+  parallelize(samples, [&] (int a, int b) {
+    for(int s=a; s<b; s++) bmu[s] = bmu_index_each ? bmu_index.find(data[s].val) : brute_winner(data[s].val);
+    return 0;
+    });
+  whowon.resize(samples);
+  for(int s=0; s<samples; s++) whowon[s] = &net[bmu[s]];
+
+  /* sum the samples won by each neuron, in the order of samples */
+  vector<int> won(cells+1, 0);
+  for(int s=0; s<samples; s++) won[bmu[s]+1]++;
+  for(int i=0; i<cells; i++) won[i+1] += won[i];
+  vector<int> order(samples);
+  auto pos = won;
+  for(int s=0; s<samples; s++) order[pos[bmu[s]]++] = s;
+
+  vector<double> vsum(size_t(cells) * columns, 0);
+  parallelize(cells, [&] (int a, int b) {
+    for(int i=a; i<b; i++) for(int j=won[i]; j<won[i+1]; j++) {
+      auto& v = data[order[j]].val;
+      for(int k=0; k<columns; k++) vsum[size_t(i)*columns+k] += v[k];
+      }
+    return 0;
+    });
+
+  setindex(true);
+  vector<pair<int, int>> cid(cells);
+  for(int i=0; i<cells; i++) cid[i] = get_cellcrawler_id(net[i].where);
+
+  /* every thread spreads the sums of its own range of winners into its own buffers */
+  int nt = max(threads, 1);
+  vector<vector<double>> num(nt), den(nt);
+  parallelize(nt, [&] (int k0, int k1) {
+    vector<cellwalker> targets;
+    for(int k=k0; k<k1; k++) {
+      num[k].assign(size_t(cells) * columns, 0);
+      den[k].assign(cells, 0);
+      for(int i=cells*k/nt; i<cells*(k+1)/nt; i++) {
+        int qty = won[i+1] - won[i];
+        if(!qty) continue;
+        auto& cr = scc.at(cid[i].first);
+        cr.sprawl_to(cellwalker(net[i].where, cid[i].second), targets);
+        int dispid = int(isize(cr.dispersion) * tt);
+        for(int j=0; j<isize(cr.data); j++) {
+          neuron *n2 = getNeuron(targets[j].at);
+          if(!n2) continue;
+          double h = gaussian ? exp(-sqr(cr.data[j].dist/sigma)) : cr.dispersion[dispid][j];
+          size_t id2 = neuronId(*n2);
+          den[k][id2] += h * qty;
+          for(int c=0; c<columns; c++) num[k][id2*columns+c] += h * vsum[size_t(i)*columns+c];
+          }
+        }
+      }
+    return 0;
+    });
+
+  /* the buffers are added in a fixed order, so the result does not depend on the scheduling */
+  parallelize(cells, [&] (int a, int b) {
+    for(int i=a; i<b; i++) {
+      double d = 0;
+      for(int k=0; k<nt; k++) d += den[k][i];
+      if(d <= 0) continue;
+      for(int c=0; c<columns; c++) {
+        double n = 0;
+        for(int k=0; k<nt; k++) n += num[k][size_t(i)*columns+c];
+        net[i].net[c] = n / d;
+        }
+      }
+    return 0;
+    });
+
+  bmu_index.clear();
+  t -= min(t, samples);
+  if(t == 0) analyze();
+  }
+
 void step() {
 
   if(t == 0) return;
+  if(batch_som) return batch_step();
   initialize_dispersion();
   initialize_neurons_initial();
   
@@ -656,6 +868,8 @@ void step() {
   double sigma = maxdist * tt;
 
   int id = hrand(samples);
+  if(bmu_index_each && (!bmu_index.built() || t > bmu_index.built_t || bmu_index.built_t - t >= bmu_index_each))
+    bmu_index.build();
   neuron& n = winner(id);
   whowon.resize(samples);
   whowon[id] = &n;
@@ -675,18 +889,21 @@ void step() {
   cellcrawler& s = scc[cid.first];
   s.sprawl(cellwalker(n.where, cid.second));
 
-  vector<float> fake(0,0);
   /* for(auto& sd: s.data) 
     fake.push_back(exp(-sqr(sd.dist/sigma))); */
   
   int dispersion_count = isize(s.dispersion);
   int dispid = int(dispersion_count * tt);
 
-  auto it = gaussian ? fake.begin() : s.dispersion[dispid].begin();
+  const vector<float> *disp = gaussian ? nullptr : &s.dispersion[dispid];
+  bool track = bmu_index_each && bmu_index.built();
+  setindex(true);
 
-  for(auto& sd: s.data) {
+  /* the online step is done by a single thread: starting threads for every sample would cost more than the update itself */
+  for(int i=0; i<isize(s.data); i++) {
+    auto& sd = s.data[i];
     neuron *n2 = getNeuron(sd.target.at);
-    if(!n2) { it++; continue; }
+    if(!n2) continue;
     n2->debug++;
     double nu = learning_factor;
     
@@ -696,13 +913,17 @@ void step() {
         throw hr_exception(lalign(0, "obtained nan, ", sd.dist, " / ", sigma));
       }
     else
-      nu *= *(it++);
+      nu *= (*disp)[i];
     
+    double moved = 0;
     for(int k=0; k<columns; k++) {
-      n2->net[k] += nu * (data[id].val[k] - n2->net[k]);
+      double delta = nu * (data[id].val[k] - n2->net[k]);
+      n2->net[k] += delta;
+      if(track) moved += sqr(delta * weights[k]);
       /* if(isnan(n2->net[k]))
         throw hr_exception("obtained nan somehow, nu = " + lalign(0, nu)); */
       }
+    if(track) bmu_index.maxdrift = max(bmu_index.maxdrift, bmu_index.moved(neuronId(*n2), sqrt(moved)));
     }
 
   /* for(auto& n2: net) {
@@ -851,6 +1072,7 @@ void create_neurons() {
 void set_neuron_initial() {
   initialize_neurons();
   DEBBI(debug_kohonen, ("Setting initial neuron values"));
+  bmu_index.clear();
   for(int i=0; i<cells; i++) {
     alloc(net[i].net);
     for(int k=0; k<columns; k++)
@@ -1107,6 +1329,7 @@ void kload(const string& fname) {
       println(hlog, "Error: bad number of cells ", tie(xcells, cells));
     throw hr_exception("bad number of SOM cells");
     }
+  bmu_index.clear();
   for(neuron& n: net) {
     for(int k=0; k<columns; k++) if(!scan(f, n.net[k])) return;
     }
@@ -1191,14 +1414,17 @@ void do_classify() {
     printf("Classifying...\n");
     bids.resize(samples, 0);
     bdiffs.resize(samples, 1e20);
-    for(int s=0; s<samples; s++) {
-      for(int n=0; n<cells; n++) {
-        double diff = vnorm(net[n].net, data[s].val);
-        if(diff < bdiffs[s]) bdiffs[s] = diff, bids[s] = n, whowon[s] = &net[n];
+    whowon.resize(samples);
+    if(bmu_index_each) bmu_index.build();
+    parallelize(samples, [&] (int a, int b) {
+      for(int s=a; s<b; s++) {
+        int n = bmu_index_each ? bmu_index.find(data[s].val) : brute_winner(data[s].val);
+        bdiffs[s] = vnorm(net[n].net, data[s].val), bids[s] = n, whowon[s] = &net[n];
+        if(!(s % 128) && threads == 1)
+          progress("Classifying: " + its(s) + "/" + its(samples));
         }
-      if(!(s % 128))
-        progress("Classifying: " + its(s) + "/" + its(samples));
-      }
+      return 0;
+      });
     }
   if(bdiffs.empty()) {
     printf("Computing distances...\n");
@@ -1633,6 +1859,16 @@ int readArgs() {
 
   // #2: set parameters
 
+  else if(argis("-som-bmu-index")) {
+    shift(); bmu_index_each = argi();
+    bmu_index.clear();
+    }
+  else if(argis("-som-batch")) {
+    shift(); batch_som = argi();
+    }
+  else if(argis("-som-threads")) {
+    shift(); threads = max(argi(), 1);
+    }
   else if(argis("-somskrad")) {
     shift(); krad = argi();
     state &=~ (KS_NEURONS | KS_NEURONS_INI | KS_DISPERSION);
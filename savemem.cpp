@@ -173,6 +173,11 @@ EX void save_memory() {
   sort(removed_cells.begin(), removed_cells.end());
   callhooks(hooks_removecells);
   removed_cells.clear();
+
+  #ifndef NO_TAILORED_ALLOC
+  size_t released = tailored_arena.release_empty();
+  DEBB(debug_memory, ("released ", int(released >> 10), " KB of empty slabs"));
+  #endif
   }
 
 EX purehookset hooks_removecells;
@@ -281,6 +286,8 @@ EX void show_memory_menu() {
     });
 #endif
 
+  add_edit(cgi_cache_limit);
+
   dialog::addItem(XLAT("clear caches"), 'c');
   dialog::add_action([] { callhooks(hooks_clear_cache); });
 
@@ -186,7 +186,7 @@ EX always_false in;
     #if ISWEB
     f.s = "";
     #else
-    f.f = fopen(fname.c_str(), "wt");
+    f.f = shot::dry_run ? tmpfile() : fopen(fname.c_str(), "wt");
     #endif
 
     println(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"", coord(vid.xres), "\" height=\"", coord(vid.yres), "\">");
@@ -196,7 +196,7 @@ EX always_false in;
     println(f, "</svg>");
     
     #if ISWEB
-    EM_ASM_({
+    if(!shot::dry_run) EM_ASM_({
       var x=window.open();
       x.document.open();
       x.document.write(UTF8ToString($0));
@@ -538,6 +538,7 @@ EX always_false in;
     ptds.clear();
     all_data.clear();
     what();
+    if(shot::dry_run) return;
 
     f.f = fopen(fname.c_str(), "wt");
     
@@ -665,6 +666,10 @@ EX int shotformat = -1;
 EX string caption;
 EX ld fade = 1;
 
+/** draw the picture as usual, but do not read it back nor save it; used for the frames skipped by anim_shard,
+ *  so that drawing generates the same cells (and uses the random number generator the same way) as in a full run */
+EX bool dry_run = false;
+
 void set_shotx() {
   if(shotformat == -1) return;
   shotx = shoty;
@@ -694,10 +699,182 @@ EX SDL_Surface *empty_surface(int x, int y, bool alpha) {
   }
 #endif
 
+#if CAP_VIDEO
+/** the maximum number of video frames waiting for the encoder; 0 = write them synchronously */
+EX int video_queue = 4;
+
+/** the number of pixel buffer objects used to read video frames asynchronously; 0 = read them synchronously */
+EX int video_pbo = 2;
+#endif
+
+#if CAP_VIDEO && CAP_THREAD
+struct video_frame {
+  vector<char> data;
+  int row;
+  bool bottom_up;
+  };
+
+/** sends the frames to the encoder pipe from a separate thread, so that rendering the next frame overlaps
+ *  with the readback and encoding of the previous ones */
+struct video_stream {
+  int handle;
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<video_frame> queue;
+  vector<vector<char>> spare;
+  bool finished;
+  std::thread writer;
+
+  #if CAP_GL
+  vector<GLuint> pbos;
+  int pbo_x, pbo_y, pbo_next, pbo_pending;
+  #endif
+
+  video_stream(int handle);
+  ~video_stream();
+  vector<char> get_buffer(int size);
+  void push(vector<char>&& data, int row, bool bottom_up);
+  void write_loop();
+  void add_surface(SDL_Surface *s, int x, int y);
+  #if CAP_GL
+  void read_gl(int x, int y);
+  void collect();
+  void flush_pbos();
+  void release_pbos();
+  #endif
+  };
+
+video_stream::video_stream(int handle) : handle(handle) {
+  finished = false;
+  #if CAP_GL
+  pbo_x = pbo_y = pbo_next = pbo_pending = 0;
+  #endif
+  writer = std::thread([this] { write_loop(); });
+  }
+
+video_stream::~video_stream() {
+  #if CAP_GL
+  release_pbos();
+  #endif
+  {
+  std::unique_lock<std::mutex> lk(lock);
+  finished = true;
+  }
+  cv.notify_all();
+  writer.join();
+  }
+
+vector<char> video_stream::get_buffer(int size) {
+  vector<char> res;
+  std::unique_lock<std::mutex> lk(lock);
+  if(!spare.empty()) { res = std::move(spare.back()); spare.pop_back(); }
+  lk.unlock();
+  res.resize(size);
+  return res;
+  }
+
+void video_stream::push(vector<char>&& data, int row, bool bottom_up) {
+  std::unique_lock<std::mutex> lk(lock);
+  cv.wait(lk, [this] { return isize(queue) < video_queue; });
+  queue.push_back(video_frame{std::move(data), row, bottom_up});
+  lk.unlock();
+  cv.notify_all();
+  }
+
+void video_stream::write_loop() {
+  while(true) {
+    std::unique_lock<std::mutex> lk(lock);
+    cv.wait(lk, [this] { return finished || !queue.empty(); });
+    if(queue.empty()) return;
+    video_frame f = std::move(queue.front());
+    queue.pop_front();
+    lk.unlock();
+    cv.notify_all();
+
+    int rows = isize(f.data) / f.row;
+    if(!f.bottom_up)
+      ignore(write(handle, f.data.data(), isize(f.data)));
+    else for(int r=rows-1; r>=0; r--)
+      ignore(write(handle, &f.data[r * f.row], f.row));
+
+    lk.lock();
+    spare.push_back(std::move(f.data));
+    }
+  }
+
+void video_stream::add_surface(SDL_Surface *s, int x, int y) {
+  /* earlier frames may still wait in the PBOs; they have to be sent first */
+  #if CAP_GL
+  flush_pbos();
+  #endif
+  auto data = get_buffer(4 * x * y);
+  for(int iy=0; iy<y; iy++)
+    memcpy(&data[4 * x * iy], &qpixel(s, 0, iy), 4 * x);
+  push(std::move(data), 4 * x, false);
+  }
+
+#if CAP_GL
+/** read the current framebuffer into the next PBO; the oldest pending PBO is mapped only when the ring is full,
+ *  by which time its transfer has usually completed */
+void video_stream::read_gl(int x, int y) {
+  if(x != shotx || y != shoty) throw hr_exception("video_stream: the frame size does not match the video size");
+  if(x != pbo_x || y != pbo_y) release_pbos();
+  if(pbos.empty()) {
+    pbo_x = x; pbo_y = y;
+    pbos.resize(video_pbo);
+    glGenBuffers(video_pbo, &pbos[0]);
+    for(auto b: pbos) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, b);
+      glBufferData(GL_PIXEL_PACK_BUFFER, 4 * x * y, nullptr, GL_STREAM_READ);
+      }
+    GLERR("video PBO init");
+    }
+  if(pbo_pending == isize(pbos)) collect();
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[pbo_next]);
+  glReadPixels(0, 0, x, y, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  GLERR("video readPixels");
+  pbo_next = (pbo_next + 1) % isize(pbos);
+  pbo_pending++;
+  }
+
+/** hand the oldest pending PBO to the writer thread */
+void video_stream::collect() {
+  int id = (pbo_next + isize(pbos) - pbo_pending) % isize(pbos);
+  int size = 4 * pbo_x * pbo_y;
+  auto data = get_buffer(size);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[id]);
+  auto ptr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+  if(ptr) memcpy(&data[0], ptr, size);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  GLERR("video map PBO");
+  pbo_pending--;
+  push(std::move(data), 4 * pbo_x, true);
+  }
+
+void video_stream::flush_pbos() {
+  while(pbo_pending) collect();
+  }
+
+void video_stream::release_pbos() {
+  flush_pbos();
+  if(!pbos.empty()) glDeleteBuffers(isize(pbos), &pbos[0]);
+  pbos.clear();
+  pbo_next = 0;
+  }
+#endif
+
+video_stream *vstream;
+#endif
+
 #if CAP_PNG
 
 EX void output(SDL_Surface* s, const string& fname) {
   if(format == screenshot_format::rawfile) {
+    #if CAP_VIDEO && CAP_THREAD
+    if(vstream) { vstream->add_surface(s, shotx, shoty); return; }
+    #endif
     for(int y=0; y<shoty; y++)
       ignore(write(rawfile_handle, &qpixel(s, 0, y), 4 * shotx));
     }
@@ -761,8 +938,15 @@ void render_png(string fname, const function<void()>& what) {
   #endif
   glbuf.clear(backcolor);
   what();
+
+  #if CAP_VIDEO && CAP_THREAD && CAP_GL
+  if(vstream && !dry_run && video_pbo > 0 && glbuf.FramebufferName && glbuf.x == shotx && glbuf.y == shoty && !transparent && gamma == 1 && shot_aa == 1 && hooks_postprocess.empty()) {
+    vstream->read_gl(glbuf.x, glbuf.y);
+    return;
+    }
+  #endif
   
-  SDL_Surface *sdark = glbuf.render();
+  SDL_Surface *sdark = dry_run ? nullptr : glbuf.render();
 
   if(transparent) {
     renderbuffer glbuf1(vid.xres, vid.yres, vid.usingGL);
@@ -775,9 +959,9 @@ void render_png(string fname, const function<void()>& what) {
     current_display->set_viewport(0);
     what();
     
-    postprocess(fname, sdark, glbuf1.render());
+    if(!dry_run) postprocess(fname, sdark, glbuf1.render());
     }
-  else postprocess(fname, sdark, sdark);
+  else if(!dry_run) postprocess(fname, sdark, sdark);
   }
 #endif
 
@@ -1464,15 +1648,36 @@ EX int record_frame_id = -1;
 
 EX bool recording_video;
 
+/** when rendering in shards, this process renders only the shard anim_shard out of anim_shards (a contiguous range of frames)
+ *
+ *  The frames before the range are drawn as a dry run (see shot::dry_run): drawing may generate new cells, and the map
+ *  generator uses the random number generator, so they have to be drawn for the state to match a full run. Only the
+ *  readback and the encoding are skipped.
+ */
+EX int anim_shard = 0, anim_shards = 1;
+
+/** the file name for the given shard of the video */
+EX string shard_filename(const string& fname, int shard) {
+  auto dot = fname.rfind('.');
+  if(dot == string::npos || fname.find('/', dot) != string::npos) dot = isize(fname);
+  return fname.substr(0, dot) + hr::format(".shard%03d", shard) + fname.substr(dot);
+  }
+
 EX bool record_animation_of(reaction_t content) {
   lastticks = 0;
   ticks = 0;
   int oldturn = -1;
   dynamicval<bool> rv(recording_video, true);
-  for(int i=0; i<noframes; i++) {
+  int first = min_frame, last = max_frame;
+  if(anim_shards > 1) {
+    first = max(first, noframes * anim_shard / anim_shards);
+    last = min(last, noframes * (anim_shard+1) / anim_shards - 1);
+    }
+  for(int i=0; i<noframes && i<=last; i++) {
     record_frame_id = i;
-    if(i < min_frame || i > max_frame) continue;
-    if(debug_progress)
+    /* frames before the range are drawn as a dry run, so that the game state and the map are as in a full run */
+    bool render = i >= first;
+    if(debug_progress && render)
       println(hlog, "record frame ",i, "/", noframes, " of ", videofile);
     callhooks(hooks_record_anim, i, noframes);
     int newticks = i * period / noframes;
@@ -1497,6 +1702,7 @@ EX bool record_animation_of(reaction_t content) {
       }
     if(playermoved) centerpc(INF), optimizeview();
     dynamicval<bool> v2(inHighQual, true);
+    dynamicval<bool> dr(shot::dry_run, !render);
     models::configure();
     if(history::on) {
       ld len = (isize(history::v)-1) + 2 * history::extra_line_steps;
@@ -1524,6 +1730,8 @@ EX purehookset hooks_after_video;
 
 #if CAP_VIDEO
 EX bool record_video(string fname IS(videofile), bool_reaction_t rec IS(record_animation)) {
+
+  if(anim_shards > 1) fname = shard_filename(fname, anim_shard);
   
   array<int, 2> tab;
   if(pipe(&tab[0])) {
@@ -1545,7 +1753,15 @@ EX bool record_video(string fname IS(videofile), bool_reaction_t rec IS(record_a
   close(tab[0]);
   shot::rawfile_handle = tab[1];
   dynamicval<shot::screenshot_format> sf(shot::format, shot::screenshot_format::rawfile);
-  rec();
+  #if CAP_THREAD
+  if(shot::video_queue > 0) {
+    shot::video_stream vs(tab[1]);
+    dynamicval<shot::video_stream*> dvs(shot::vstream, &vs);
+    rec();
+    }
+  else
+  #endif
+    rec();
   close(tab[1]);
   wait(nullptr);
   callhooks(hooks_after_video);
@@ -1555,6 +1771,57 @@ EX bool record_video(string fname IS(videofile), bool_reaction_t rec IS(record_a
 EX bool record_video_std() {
   return record_video(videofile, record_animation);
   }
+
+/** concatenate the shards of fname, as produced by -anim-shard, into fname */
+EX bool merge_video_shards(const string& fname, int shards) {
+  string listname = fname + ".shards.txt";
+  {
+  fhstream f(listname, "wt");
+  if(!f.f) { file_error(listname); return false; }
+  for(int k=0; k<shards; k++) {
+    /* paths in the list are relative to the list itself */
+    string name = shard_filename(fname, k);
+    auto slash = name.rfind('/');
+    if(slash != string::npos) name = name.substr(slash+1);
+    println(f, "file '", name, "'");
+    }
+  }
+  string cmd = "ffmpeg -hide_banner -loglevel error -y -f concat -safe 0 -i \"" + listname + "\" -c copy \"" + fname + "\"";
+  int res = system(cmd.c_str());
+  unlink(listname.c_str());
+  if(res) { println(hlog, "merging the shards of ", fname, " failed"); return false; }
+  return true;
+  }
+
+/** render the video in the given number of worker processes, each started with the command line arguments
+ *  in prefix (so each has its own graphics context), and merge the results */
+EX bool record_video_shards(const string& fname, int shards, const vector<string>& prefix) {
+  fflush(stdout); fflush(stderr);
+  for(int k=0; k<shards; k++) {
+    int pid = fork();
+    if(pid < 0) { addMessage(hr::format("Error: %s", strerror(errno))); return false; }
+    if(pid == 0) {
+      vector<string> worker = prefix;
+      for(string s: {string("-anim-shard"), its(k), its(shards), string("-animvideo"), its(noframes), fname, string("-exit")})
+        worker.push_back(s);
+      vector<char*> argv;
+      for(auto& s: worker) argv.push_back(&s[0]);
+      argv.push_back(nullptr);
+      execv("/proc/self/exe", &argv[0]);
+      _exit(1);
+      }
+    }
+  int failed = 0;
+  for(int k=0; k<shards; k++) {
+    int status;
+    if(wait(&status) <= 0 || !WIFEXITED(status) || WEXITSTATUS(status)) failed++;
+    }
+  if(failed) {
+    println(hlog, failed, " of ", shards, " shards of ", fname, " failed");
+    return false;
+    }
+  return merge_video_shards(fname, shards);
+  }
 #endif
 
 void display_animation() {
@@ -1809,6 +2076,11 @@ int readArgs() {
     PHASE(3); shift(); noframes = argi() ? argi() : noframes;
     shift(); animfile = args(); record_animation();
     }
+  else if(argis("-anim-shard")) {
+    PHASEFROM(2);
+    anim_shard = shift_argi();
+    anim_shards = shift_argi();
+    }
   else if(argis("-record-only")) {
     PHASEFROM(2); 
     shift(); min_frame = argi();
@@ -1821,6 +2093,21 @@ int readArgs() {
     PHASE(3); shift(); noframes = argi() ? argi() : noframes;
     shift(); videofile = args(); record_video();
     }
+  else if(argis("-animvideo-shards")) {
+    PHASE(3);
+    vector<string> prefix(argument.begin(), argument.begin() + pos);
+    int shards = shift_argi(); shift(); noframes = argi() ? argi() : noframes;
+    shift(); videofile = args(); record_video_shards(videofile, shards, prefix);
+    }
+  else if(argis("-animvideo-merge")) {
+    int shards = shift_argi(); merge_video_shards(shift_args(), shards);
+    }
+  else if(argis("-video-queue")) {
+    PHASEFROM(2); shift(); shot::video_queue = argi();
+    }
+  else if(argis("-video-pbo")) {
+    PHASEFROM(2); shift(); shot::video_pbo = argi();
+    }
 #endif
 #endif
   else return 1;
@@ -34,7 +34,13 @@ ld sqdist(shiftpoint a, shiftpoint b) {
 EX namespace shmup {
 
 #if HDR
+extern slab_arena monster_arena;
+
 struct monster {
+  /** \brief bullets are created and destroyed all the time, so monsters are kept in monster_arena */
+  static void *operator new(size_t s) { return monster_arena.alloc((s + 15) & ~15); }
+  static void operator delete(void *p, size_t s) { monster_arena.free(p, (s + 15) & ~15); }
+
   eMonster type;
   cell *base;      ///< on which base cell this monster currently is
   cell *torigin;   ///< tortoises: origin, butterflies: last position
@@ -100,6 +106,8 @@ struct monster {
   };  
 #endif
 
+slab_arena monster_arena;
+
 void monster::reset() {
   nextshot = 0;
   stunoff = 0; blowoff = 0; fragoff = 0; footphase = 0;
@@ -128,6 +136,96 @@ typedef multimap<cell*, monster*>::iterator mit;
 
 EX vector<monster*> active, nonvirtual, additional;
 
+/** \brief pairs (base, index in nonvirtual), sorted; built at the start of the turn, to find the monsters close to a cell quickly */
+vector<pair<cell*, int>> nonvirtual_index;
+
+/** \brief collision checks only consider the monsters whose base (at the start of the turn) is within this many steps;
+ *  0 = all monsters, -1 = computed from the collision radii and the cell size */
+EX int collision_cell_range = -1;
+
+/** \brief the range actually used by nonvirtual_near in this turn; -1 = all monsters */
+int near_range = -1;
+
+ld collision_radius(monster *m);
+
+void index_nonvirtual() {
+  nonvirtual_index.clear();
+  for(int i=0; i<isize(nonvirtual); i++) nonvirtual_index.emplace_back(nonvirtual[i]->base, i);
+  sort(nonvirtual_index.begin(), nonvirtual_index.end());
+
+  /* in 3D the asteroids may be larger than cells */
+  near_range = -1;
+  if(!collision_cell_range || GDIM == 3) return;
+  if(collision_cell_range > 0) { near_range = collision_cell_range; return; }
+  /* two monsters are within rhexf of the centers of their bases, and the widest check is
+   * a collision (two radii) or the sqdist < .3 * SCALE2 test; two more steps cover the neighbor
+   * of the base in the Necromancer's check, and the bases which change during the turn */
+  ld maxr = 0;
+  for(monster *m: nonvirtual) maxr = max(maxr, collision_radius(m));
+  ld reach = 2 * cgi.rhexf + max<ld>(2 * maxr, sqrt(.3) * SCALE);
+  ld step = min(cgi.crossf, cgi.hexhexdist);
+  if(!(step > 0)) return;
+  ld r = ceil(reach / step) + 2;
+  if(r <= 6) near_range = int(r);
+  }
+
+/** \brief scratch space for nonvirtual_near, kept between the calls */
+traversal_workspace near_marks;
+vector<cell*> near_cells;
+vector<int> near_found;
+
+/** \brief result buffers of nonvirtual_near; a buffer is in use while its nearby_monsters exists, so the calls may nest
+ *  (a deque, so that adding a buffer does not move the ones in use) */
+std::deque<vector<monster*>> near_results;
+int near_depth = 0;
+
+/** \brief the result of nonvirtual_near: either nonvirtual itself, or one of near_results */
+struct nearby_monsters {
+  vector<monster*> *v;
+  bool owned;
+  nearby_monsters(vector<monster*> *v, bool owned) : v(v), owned(owned) {}
+  nearby_monsters(nearby_monsters&& other) : v(other.v), owned(other.owned) { other.owned = false; }
+  nearby_monsters(const nearby_monsters&) = delete;
+  ~nearby_monsters() { if(owned) near_depth--; }
+  vector<monster*>::iterator begin() { return v->begin(); }
+  vector<monster*>::iterator end() { return v->end(); }
+  };
+
+/** \brief the monsters from nonvirtual which could be close to c, in the same order as in nonvirtual
+ *
+ *  The result must not outlive the current turn; nonvirtual must not be changed while it is used.
+ */
+nearby_monsters nonvirtual_near(cell *c) {
+  if(near_range < 0) return nearby_monsters(&nonvirtual, false);
+  near_marks.reset();
+  near_cells.clear();
+  near_cells.push_back(c);
+  near_marks.mark(c);
+  int from = 0;
+  for(int d=0; d<near_range; d++) {
+    int to = isize(near_cells);
+    for(int i=from; i<to; i++) {
+      cell *c1 = near_cells[i];
+      for(int j=0; j<c1->type; j++) {
+        cell *c2 = c1->move(j);
+        if(c2 && near_marks.mark(c2)) near_cells.push_back(c2);
+        }
+      }
+    from = to;
+    }
+  near_found.clear();
+  for(cell *c1: near_cells) {
+    auto it = std::lower_bound(nonvirtual_index.begin(), nonvirtual_index.end(), make_pair(c1, -1));
+    for(; it != nonvirtual_index.end() && it->first == c1; it++) near_found.push_back(it->second);
+    }
+  sort(near_found.begin(), near_found.end());
+  if(near_depth == isize(near_results)) near_results.emplace_back();
+  auto& result = near_results[near_depth++];
+  result.clear();
+  for(int i: near_found) result.push_back(nonvirtual[i]);
+  return nearby_monsters(&result, true);
+  }
+
 cell *findbaseAround(shiftpoint p, cell *around, int maxsteps) {
 
   if(quotient || fake::split()) {
@@ -1827,7 +1925,7 @@ void moveBullet(monster *m, int delta) {
   
   bool no_self_hits = (m->type != moFlailBullet && !multi::self_hits) || m->fragoff > curtime;
 
-  if(!m->isVirtual) for(monster* m2: nonvirtual) {
+  if(!m->isVirtual) for(monster* m2: nonvirtual_near(m->base)) {
     if(m2 == m) continue;
     if((m2 == m->parent && no_self_hits) || (m2->parent == m->parent && no_self_hits)) continue;
     
@@ -2301,7 +2399,7 @@ void moveMonster(monster *m, int delta) {
 
   monster* crashintomon = NULL;
   
-  if(!m->isVirtual && !inertia_based) for(monster *m2: nonvirtual) if(m2!=m && m2->type != moBullet && m2->type != moArrowTrap) {
+  if(!m->isVirtual && !inertia_based) for(monster *m2: nonvirtual_near(m->base)) if(m2!=m && m2->type != moBullet && m2->type != moArrowTrap) {
     double d = sqdist(m2->pat*C0, nat*C0);
     if(d < SCALE2 * 0.1) crashintomon = m2;
     }
@@ -2420,7 +2518,7 @@ void moveMonster(monster *m, int delta) {
       cell *c3 = m->base->move(i);
       if(neighborId(c3, c2) != -1 && c3->wall == waFreshGrave && gmatrix.count(c3)) {
         bool monstersNear = false;
-        for(monster *m2: nonvirtual) {
+        for(monster *m2: nonvirtual_near(m->base)) {
           if(m2 != m && sqdist(m2->pat*C0, gmatrix[c3]*C0) < SCALE2 * .3)
             monstersNear = true;
           if(m2 != m && sqdist(m2->pat*C0, gmatrix[c2]*C0) < SCALE2 * .3)
@@ -2701,6 +2799,7 @@ EX void turn(int delta) {
     else nonvirtual.push_back(m);
     exists[movegroup(m->type)] = true;
     }
+  index_nonvirtual();
   
   for(monster *m: active) {
     
@@ -2971,6 +3070,7 @@ EX void clearMonsters() {
 
 EX void clearMemory() {
   clearMonsters();
+  if(!monster_arena.live) monster_arena.release_all();
   while(!traplist.empty()) traplist.pop();
   curtime = 0;
   speed_saving = 0;
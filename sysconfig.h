@@ -75,6 +75,14 @@
 #define CAP_THREAD (!ISMOBILE && !ISWEB)
 #endif
 
+#ifndef CAP_MMAP
+#define CAP_MMAP (!ISMOBILE && !ISWEB && !ISWINDOWS)
+#endif
+
+#ifndef CAP_FORK
+#define CAP_FORK (!ISMOBILE && !ISWEB && !ISWINDOWS)
+#endif
+
 #ifndef CAP_ZLIB
 #define CAP_ZLIB 1
 #endif
@@ -201,6 +209,11 @@
 #define CAP_VIDEO (CAP_SHOT && ISLINUX && CAP_SDL)
 #endif
 
+/** render with an EGL surfaceless context instead of an SDL window (-headless) */
+#ifndef CAP_EGL
+#define CAP_EGL 0
+#endif
+
 #ifndef MAXMDIM
 #define MAXMDIM 4
 #endif
@@ -595,6 +608,10 @@ extern "C" {
     #include <GL/glext.h>
   #endif
 #endif
+#if CAP_EGL
+  #include <EGL/egl.h>
+  #include <EGL/eglext.h>
+#endif
 #else
 typedef int GLint;
 typedef unsigned GLuint;
@@ -612,6 +629,7 @@ typedef unsigned GLuint;
 #include <string>
 #include <cassert>
 #include <map>
+#include <list>
 #include <queue>
 #include <sstream>
 #include <stdexcept>
@@ -684,6 +702,17 @@ typedef unsigned GLuint;
 #include <sys/stat.h>
 #endif
 
+#if CAP_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if CAP_FORK
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #if CAP_TIMEOFDAY
 #include <sys/time.h>
 #endif